@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+
+/**
+ * @brief The header that the sensor puts in front of each encoded frame that it publishes, shared by the sensor and
+ * the pipeline so that both agree on the layout.
+ *
+ * @details The header and the encoded frame are sent as a single message, since a conflating socket does not support
+ * messages with several parts. Messages that do not start with the magic bytes are taken to be a bare encoded frame,
+ * as sent by older sensors.
+ *
+ * @note The fields are in the byte order of the host, which is little endian on all supported platforms.
+ * */
+struct FrameHeader final {
+  static constexpr std::array<char, 4> expected_magic{'A', 'D', 'F', 'H'};
+
+  static constexpr std::uint32_t current_version{1};
+
+  std::array<char, 4> magic{expected_magic};
+
+  std::uint32_t version{current_version};
+
+  /**
+   * @brief The number of frames that the sensor captured before this one.
+   * */
+  std::uint64_t sequence{};
+
+  /**
+   * @brief The time at which the sensor captured the frame, in microseconds since the Unix epoch.
+   * */
+  std::int64_t capture_time_us{};
+
+  /**
+   * @brief Reads the header at the start of a message.
+   *
+   * @return The header, or nothing if the message does not start with one.
+   * */
+  [[nodiscard]] static auto Parse(const void* data, const std::size_t size) -> std::optional<FrameHeader> {
+    if (size < sizeof(FrameHeader)) {
+      return std::nullopt;
+    }
+    FrameHeader header;
+    std::memcpy(&header, data, sizeof(FrameHeader));
+    if ((header.magic != expected_magic) || (header.version != current_version)) {
+      return std::nullopt;
+    }
+    return header;
+  }
+};
+
+static_assert(sizeof(FrameHeader) == 24, "The frame header layout is part of the wire format.");
@@ -0,0 +1,141 @@
+#include "synthetic_anomalies.h"
+
+#include <algorithm>
+#include <cmath>
+#include <opencv2/imgproc.hpp>
+#include <sstream>
+
+namespace synthetic {
+
+namespace {
+
+/**
+ * @brief Mixed into the seed of the texture, so that its engine does not start in the same state as the one that draws
+ * the anomalies.
+ * */
+constexpr std::uint32_t texture_stream{0x54455854};
+
+}  // namespace
+
+auto KindName(const AnomalyKind kind) -> const char* {
+  switch (kind) {
+    case AnomalyKind::kScratch:
+      return "SCRATCH";
+    case AnomalyKind::kColorShift:
+      return "COLOR_SHIFT";
+    case AnomalyKind::kPatch:
+    default:
+      return "PATCH";
+  }
+}
+
+auto ProceduralTexture(const int width, const int height, const int channels, const std::uint64_t seed) -> cv::Mat {
+  std::seed_seq sequence{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32U), texture_stream};
+  std::mt19937_64 rng(sequence);
+  cv::Mat texture(height, width, CV_8UC(channels));
+  std::uniform_int_distribution<int> noise(-12, 12);
+  for (int y = 0; y < height; y++) {
+    auto* row = texture.ptr<std::uint8_t>(y);
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < channels; c++) {
+        const auto wave = 40.0 * std::sin(x * 0.05 + c) * std::cos(y * 0.03 - c) + 20.0 * std::sin((x + y) * 0.2);
+        row[x * channels + c] = cv::saturate_cast<std::uint8_t>(128.0 + wave + noise(rng));
+      }
+    }
+  }
+  return texture;
+}
+
+void DrawBackground(const cv::Mat& background, const std::uint64_t sequence, cv::Mat& frame) {
+  const auto w = background.cols;
+  const auto shift = static_cast<int>((sequence * background_step) % static_cast<std::uint64_t>(w));
+  if (shift == 0) {
+    background.copyTo(frame);
+    return;
+  }
+  background.colRange(shift, w).copyTo(frame.colRange(0, w - shift));
+  background.colRange(0, shift).copyTo(frame.colRange(w - shift, w));
+}
+
+auto DrawAnomaly(cv::Mat& frame, const std::vector<AnomalyKind>& kinds, const int min_size, const int max_size,
+                 std::mt19937_64& rng) -> Anomaly {
+  std::uniform_int_distribution<int> size(min_size, max_size);
+  Anomaly anomaly;
+  anomaly.width = size(rng);
+  anomaly.height = size(rng);
+  anomaly.x = std::uniform_int_distribution<int>(0, frame.cols - anomaly.width)(rng);
+  anomaly.y = std::uniform_int_distribution<int>(0, frame.rows - anomaly.height)(rng);
+  anomaly.kind = kinds[std::uniform_int_distribution<std::size_t>(0, kinds.size() - 1)(rng)];
+
+  const auto x = anomaly.x;
+  const auto y = anomaly.y;
+  const auto w = anomaly.width;
+  const auto h = anomaly.height;
+
+  std::bernoulli_distribution coin(0.5);
+
+  switch (anomaly.kind) {
+    case AnomalyKind::kScratch: {
+      // Note: The line runs between opposite corners of the rectangle, inset by its thickness, so that the rectangle
+      //       encloses it tightly at any angle.
+      const auto thickness = std::uniform_int_distribution<int>(1, 3)(rng);
+      const auto inset = thickness / 2;
+      const auto falling = coin(rng);
+      const cv::Point start(x + inset, falling ? (y + inset) : (y + h - 1 - inset));
+      const cv::Point end(x + w - 1 - inset, falling ? (y + h - 1 - inset) : (y + inset));
+      const auto value = coin(rng) ? 255.0 : 0.0;
+      cv::line(frame, start, end, cv::Scalar::all(value), thickness, cv::LINE_8);
+      break;
+    }
+    case AnomalyKind::kColorShift: {
+      std::uniform_int_distribution<int> offset(40, 80);
+      cv::Scalar shift;
+      for (int c = 0; c < 3; c++) {
+        const auto magnitude = offset(rng);
+        shift[c] = magnitude * (coin(rng) ? 1.0 : -1.0);
+      }
+      auto region = frame(cv::Rect(x, y, w, h));
+      cv::add(region, shift, region);
+      break;
+    }
+    case AnomalyKind::kPatch:
+    default: {
+      std::uniform_int_distribution<int> intensity(0, 255);
+      cv::Scalar color;
+      for (int c = 0; c < 3; c++) {
+        color[c] = intensity(rng);
+      }
+      frame(cv::Rect(x, y, w, h)).setTo(color);
+      break;
+    }
+  }
+
+  return anomaly;
+}
+
+void DrawAnomalies(cv::Mat& frame, const double probability, const std::uint32_t max_count,
+                   const std::vector<AnomalyKind>& kinds, const int min_size, const int max_size, std::mt19937_64& rng,
+                   std::vector<Anomaly>& anomalies) {
+  anomalies.clear();
+  if (!std::bernoulli_distribution(probability)(rng)) {
+    return;
+  }
+  const auto count = std::uniform_int_distribution<std::uint32_t>(1, std::max(max_count, 1U))(rng);
+  for (std::uint32_t i = 0; i < count; i++) {
+    anomalies.emplace_back(DrawAnomaly(frame, kinds, min_size, max_size, rng));
+  }
+}
+
+auto GroundTruthJson(const std::uint64_t sequence, const std::vector<Anomaly>& anomalies) -> std::string {
+  std::ostringstream json;
+  json << R"({"sequence":")" << sequence << R"(","anomalies":[)";
+  for (std::size_t i = 0; i < anomalies.size(); i++) {
+    const auto& anomaly = anomalies[i];
+    json << ((i > 0) ? "," : "") << R"({"kind":")" << KindName(anomaly.kind) << R"(","x":)" << anomaly.x
+         << R"(,"y":)" << anomaly.y << R"(,"width":)" << anomaly.width << R"(,"height":)" << anomaly.height << "}";
+  }
+  json << "]}";
+  return json.str();
+}
+
+}  // namespace synthetic
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Drawing of synthetic frames and their ground truth, shared by the synthetic sources of the sensor and the
+ * pipeline so that both write the same ground truth format.
+ *
+ * @details Given the same seed, size, number of channels, kinds and sizes of anomalies, both sources draw the same
+ * frames: the texture comes from its own engine, derived from the seed, and the anomalies from an engine seeded with
+ * the seed itself, in the same order on both sides.
+ * */
+namespace synthetic {
+
+/**
+ * @note The values match the AnomalyKind enum of the pipeline configuration.
+ * */
+enum class AnomalyKind : std::uint8_t {
+  /**
+   * @brief A filled rectangle of a random color.
+   * */
+  kPatch = 0,
+
+  /**
+   * @brief A thin straight line at a random angle.
+   * */
+  kScratch = 1,
+
+  /**
+   * @brief A rectangle in which the color of the background is offset.
+   * */
+  kColorShift = 2
+};
+
+/**
+ * @brief An anomaly that was drawn into a frame, and the rectangle that encloses it.
+ * */
+struct Anomaly final {
+  AnomalyKind kind{AnomalyKind::kPatch};
+
+  int x{};
+
+  int y{};
+
+  int width{};
+
+  int height{};
+};
+
+/**
+ * @brief How far the background moves between frames, in pixels.
+ * */
+constexpr int background_step{7};
+
+/**
+ * @brief The default range of the size of anomalies, in pixels.
+ * */
+constexpr int default_min_anomaly_size{16};
+
+constexpr int default_max_anomaly_size{64};
+
+/**
+ * @brief The kinds that are drawn when none are configured, in the order in which they are chosen from.
+ * */
+inline const std::vector<AnomalyKind> all_kinds{AnomalyKind::kPatch, AnomalyKind::kScratch, AnomalyKind::kColorShift};
+
+[[nodiscard]] auto KindName(AnomalyKind kind) -> const char*;
+
+/**
+ * @brief Creates a texture of waves and noise, which has structure at several scales like a real surface, and in
+ * which tiles differ from each other.
+ *
+ * @details The noise is drawn from an engine of its own, derived from the seed, so that an engine seeded with the
+ * same seed for the anomalies is not advanced by the size of the texture.
+ * */
+[[nodiscard]] auto ProceduralTexture(int width, int height, int channels, std::uint64_t seed) -> cv::Mat;
+
+/**
+ * @brief Copies the background into a frame, shifted to the left by @ref background_step pixels per frame.
+ *
+ * @param frame A frame of the same size and type as the background.
+ * */
+void DrawBackground(const cv::Mat& background, std::uint64_t sequence, cv::Mat& frame);
+
+/**
+ * @brief Draws an anomaly of a random size, position and kind.
+ *
+ * @param kinds The kinds to choose from, which must not be empty.
+ * @param max_size The largest size of the anomaly, which must fit into the frame.
+ * */
+[[nodiscard]] auto DrawAnomaly(cv::Mat& frame, const std::vector<AnomalyKind>& kinds, int min_size, int max_size,
+                               std::mt19937_64& rng) -> Anomaly;
+
+/**
+ * @brief Decides whether a frame has anomalies, and draws between one and @p max_count of them if it does.
+ *
+ * @param anomalies Replaced by the anomalies that were drawn, which may be none.
+ * */
+void DrawAnomalies(cv::Mat& frame, double probability, std::uint32_t max_count, const std::vector<AnomalyKind>& kinds,
+                   int min_size, int max_size, std::mt19937_64& rng, std::vector<Anomaly>& anomalies);
+
+/**
+ * @brief Formats the ground truth of a frame as one line of JSON, without the line break.
+ *
+ * @details Every field is written, including zeros and an empty list of anomalies. The sequence is a string, as in
+ * the JSON mapping of 64-bit integers in protobuf.
+ * */
+[[nodiscard]] auto GroundTruthJson(std::uint64_t sequence, const std::vector<Anomaly>& anomalies) -> std::string;
+
+}  // namespace synthetic
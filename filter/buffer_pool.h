@@ -0,0 +1,205 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "image.h"
+#include "tensor.h"
+
+/**
+ * @brief Recycles buffers, so that the steady state of the pipeline does not allocate them.
+ *
+ * @details Buffers are handed out as shared pointers. Once the last reference to a buffer is released, it returns to
+ * the pool and is handed out again for the next request with the same key. Buffers that are handed out again are not
+ * cleared.
+ *
+ * @tparam T The type of buffer.
+ * @tparam Key The type that identifies which buffers are interchangeable, such as their shape.
+ *
+ * @note The pool may be used from several threads at once. It must be created with @ref BufferPool::Create, and
+ * buffers may outlive it.
+ *
+ * @note The control blocks of the shared pointers are recycled by the pool as well, so that handing out a buffer
+ * that is reused does not allocate.
+ * */
+template <typename T, typename Key>
+class BufferPool final : public std::enable_shared_from_this<BufferPool<T, Key>> {
+ public:
+  [[nodiscard]] static auto Create() -> std::shared_ptr<BufferPool> {
+    return std::shared_ptr<BufferPool>(new BufferPool());
+  }
+
+  /**
+   * @brief Gets a buffer, reusing a released one with the same key if there is one.
+   *
+   * @param args The arguments to construct a new buffer with, if none can be reused.
+   * */
+  template <typename... Args>
+  [[nodiscard]] auto Acquire(const Key& key, Args&&... args) -> std::shared_ptr<T> {
+    std::unique_ptr<T> buffer;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto it = free_.begin(); it != free_.end(); it++) {
+        if (it->first == key) {
+          buffer = std::move(it->second);
+          free_.erase(it);
+          break;
+        }
+      }
+    }
+
+    if (!buffer) {
+      buffer = std::make_unique<T>(std::forward<Args>(args)...);
+    }
+
+    return Wrap(key, std::move(buffer));
+  }
+
+  /**
+   * @brief Allocates buffers until at least the given number with the same key are free.
+   * */
+  template <typename... Args>
+  void Reserve(const Key& key, const std::size_t count, Args&&... args) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::size_t num_free{};
+    for (const auto& entry : free_) {
+      num_free += (entry.first == key) ? 1 : 0;
+    }
+
+    for (; num_free < count; num_free++) {
+      free_.emplace_back(key, std::make_unique<T>(args...));
+    }
+  }
+
+  BufferPool(const BufferPool&) = delete;
+
+  ~BufferPool() {
+    for (auto* block : free_blocks_) {
+      ::operator delete(block);
+    }
+  }
+
+  auto operator=(const BufferPool&) -> BufferPool& = delete;
+
+ protected:
+  /**
+   * @brief Allocates the control blocks of the shared pointers that the pool hands out, from the blocks that the pool
+   * has recycled if there are any.
+   *
+   * @details All control blocks of a pool have the same type, so any recycled block fits. Blocks that are released
+   * after the pool is gone are deleted.
+   * */
+  template <typename U>
+  class BlockAllocator final {
+   public:
+    using value_type = U;
+
+    template <typename V>
+    struct rebind final {
+      using other = BlockAllocator<V>;
+    };
+
+    explicit BlockAllocator(std::weak_ptr<BufferPool> pool) noexcept : pool_(std::move(pool)) {}
+
+    template <typename V>
+    BlockAllocator(const BlockAllocator<V>& other) noexcept : pool_(other.pool_) {}
+
+    [[nodiscard]] auto allocate(const std::size_t n) -> U* {
+      const auto size = n * sizeof(U);
+      if (auto pool = pool_.lock()) {
+        std::lock_guard<std::mutex> lock(pool->mutex_);
+        if (!pool->free_blocks_.empty() && (pool->block_size_ == size)) {
+          auto* block = pool->free_blocks_.back();
+          pool->free_blocks_.pop_back();
+          return static_cast<U*>(block);
+        }
+      }
+      return static_cast<U*>(::operator new(size));
+    }
+
+    void deallocate(U* ptr, const std::size_t n) noexcept {
+      const auto size = n * sizeof(U);
+      if (auto pool = pool_.lock()) {
+        std::lock_guard<std::mutex> lock(pool->mutex_);
+        if (pool->free_blocks_.empty() || (pool->block_size_ == size)) {
+          pool->block_size_ = size;
+          // Note: This only allocates until the list has room for the most buffers that were out at once.
+          pool->free_blocks_.push_back(ptr);
+          return;
+        }
+      }
+      ::operator delete(ptr);
+    }
+
+    template <typename V>
+    [[nodiscard]] auto operator==(const BlockAllocator<V>& other) const noexcept -> bool {
+      return !pool_.owner_before(other.pool_) && !other.pool_.owner_before(pool_);
+    }
+
+   private:
+    template <typename V>
+    friend class BlockAllocator;
+
+    std::weak_ptr<BufferPool> pool_;
+  };
+
+  BufferPool() = default;
+
+  [[nodiscard]] auto Wrap(const Key& key, std::unique_ptr<T> buffer) -> std::shared_ptr<T> {
+    std::weak_ptr<BufferPool> pool = this->shared_from_this();
+    auto deleter = [pool, key](T* ptr) {
+      std::unique_ptr<T> owned(ptr);
+      if (auto self = pool.lock()) {
+        std::lock_guard<std::mutex> lock(self->mutex_);
+        self->free_.emplace_back(key, std::move(owned));
+      }
+    };
+    return std::shared_ptr<T>(buffer.release(), std::move(deleter), BlockAllocator<T>(pool));
+  }
+
+ private:
+  std::mutex mutex_;
+
+  std::vector<std::pair<Key, std::unique_ptr<T>>> free_;
+
+  /**
+   * @brief Control blocks that were released, which all have the size @ref block_size_.
+   * */
+  std::vector<void*> free_blocks_;
+
+  std::size_t block_size_{};
+};
+
+using ImagePool = BufferPool<Image, ImageShape>;
+
+/**
+ * @brief A pool of tensors, keyed by their channels, height and width.
+ * */
+using TensorPool = BufferPool<Tensor, std::array<std::uint32_t, 3>>;
+
+/**
+ * @brief Decodes an encoded image into an image from a pool, so that decoding frames does not allocate once the pool
+ * has an image of their shape.
+ *
+ * @return The image, or null if the data could not be decoded.
+ * */
+[[nodiscard]] inline auto DecodePooled(ImagePool& pool, const void* data, const std::size_t size,
+                                       const PixelFormat format) -> std::shared_ptr<Image> {
+  const auto shape = Image::PeekShape(data, size, format);
+  if (!shape) {
+    return nullptr;
+  }
+  auto img = pool.Acquire(*shape, *shape);
+  if (img->Empty() || !img->Decode(data, size)) {
+    return nullptr;
+  }
+  return img;
+}
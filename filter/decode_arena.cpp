@@ -0,0 +1,189 @@
+#include "decode_arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+/**
+ * @brief A block that is allocated from the heap when the arena is full, and released when the next scope starts.
+ *
+ * @note The header is aligned like the allocations themselves, so that the memory after it is as well.
+ * */
+struct alignas(std::max_align_t) Overflow final {
+  Overflow* next{};
+};
+
+struct Arena final {
+  std::byte* data{};
+
+  std::size_t capacity{};
+
+  std::size_t used{};
+
+  /**
+   * @brief The most that was used at once during the current scope.
+   * */
+  std::size_t peak{};
+
+  /**
+   * @brief The start of the last allocation, which can be grown or released in place.
+   * */
+  std::byte* last{};
+
+  Overflow* overflow{};
+
+  /**
+   * @brief The number of bytes that did not fit into the arena during the current scope.
+   * */
+  std::size_t overflow_size{};
+
+  bool active{};
+
+  Arena() = default;
+
+  Arena(const Arena&) = delete;
+
+  ~Arena() {
+    ReleaseOverflow();
+    std::free(data);
+  }
+
+  auto operator=(const Arena&) -> Arena& = delete;
+
+  void ReleaseOverflow() {
+    while (overflow) {
+      auto* next = overflow->next;
+      std::free(overflow);
+      overflow = next;
+    }
+  }
+
+  [[nodiscard]] auto Contains(const void* ptr) const -> bool {
+    const auto* byte = static_cast<const std::byte*>(ptr);
+    return data && (byte >= data) && (byte < (data + capacity));
+  }
+
+  [[nodiscard]] auto IsOverflow(const void* ptr) const -> bool {
+    for (auto* block = overflow; block; block = block->next) {
+      if (ptr == static_cast<const void*>(block + 1)) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+thread_local Arena arena;
+
+[[nodiscard]] auto AlignUp(const std::size_t size) -> std::size_t {
+  constexpr auto alignment = alignof(std::max_align_t);
+  return ((std::max<std::size_t>(size, 1) + alignment - 1) / alignment) * alignment;
+}
+
+}  // namespace
+
+DecodeArena::Scope::Scope() {
+  arena.ReleaseOverflow();
+  const auto required = arena.peak + arena.overflow_size;
+  if (required > arena.capacity) {
+    // Note: The arena is grown with some room to spare, since the memory that a codec needs varies with the content.
+    const auto capacity = required + required / 2;
+    std::free(arena.data);
+    arena.data = static_cast<std::byte*>(std::malloc(capacity));
+    arena.capacity = arena.data ? capacity : 0;
+  }
+  arena.used = 0;
+  arena.peak = 0;
+  arena.last = nullptr;
+  arena.overflow_size = 0;
+  arena.active = true;
+}
+
+DecodeArena::Scope::~Scope() { arena.active = false; }
+
+auto DecodeArena::Allocate(const std::size_t size) -> void* {
+  if (!arena.active) {
+    return std::malloc(size);
+  }
+
+  const auto aligned_size = AlignUp(size);
+
+  if ((arena.used + aligned_size) <= arena.capacity) {
+    arena.last = arena.data + arena.used;
+    arena.used += aligned_size;
+    arena.peak = std::max(arena.peak, arena.used);
+    return arena.last;
+  }
+
+  auto* block = static_cast<Overflow*>(std::malloc(sizeof(Overflow) + aligned_size));
+  if (!block) {
+    return nullptr;
+  }
+  block->next = arena.overflow;
+  arena.overflow = block;
+  arena.overflow_size += aligned_size;
+  return block + 1;
+}
+
+auto DecodeArena::Reallocate(void* ptr, const std::size_t old_size, const std::size_t new_size) -> void* {
+  if (!ptr) {
+    return Allocate(new_size);
+  }
+
+  // Note: Codecs often grow the buffer that they allocated last, which can be done without moving it.
+  if (arena.active && (ptr == arena.last)) {
+    const auto offset = static_cast<std::size_t>(arena.last - arena.data);
+    const auto aligned_size = AlignUp(new_size);
+    if ((offset + aligned_size) <= arena.capacity) {
+      arena.used = offset + aligned_size;
+      arena.peak = std::max(arena.peak, arena.used);
+      return ptr;
+    }
+  }
+
+  if (!arena.active && !arena.Contains(ptr) && !arena.IsOverflow(ptr)) {
+    return std::realloc(ptr, new_size);
+  }
+
+  auto* moved = Allocate(new_size);
+  if (!moved) {
+    return nullptr;
+  }
+  std::memcpy(moved, ptr, std::min(old_size, new_size));
+  Free(ptr);
+  return moved;
+}
+
+void DecodeArena::Free(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+
+  if (arena.Contains(ptr)) {
+    if (ptr == arena.last) {
+      arena.used = static_cast<std::size_t>(arena.last - arena.data);
+      arena.last = nullptr;
+    }
+    return;
+  }
+
+  if (arena.IsOverflow(ptr)) {
+    return;
+  }
+
+  std::free(ptr);
+}
+
+// Note: These are what the codecs, which are compiled as C, are configured to allocate with.
+extern "C" {
+
+auto ad_decode_arena_malloc(const std::size_t size) -> void* { return DecodeArena::Allocate(size); }
+
+auto ad_decode_arena_realloc(void* ptr, const std::size_t old_size, const std::size_t new_size) -> void* {
+  return DecodeArena::Reallocate(ptr, old_size, new_size);
+}
+
+void ad_decode_arena_free(void* ptr) { DecodeArena::Free(ptr); }
+}
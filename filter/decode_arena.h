@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief Scratch memory that the image codecs allocate from, so that decoding and encoding frames does not allocate
+ * once the scratch memory has grown to fit the largest frame.
+ *
+ * @details Each thread has its own arena, which is only used while a @ref DecodeArena::Scope is alive on that thread.
+ * Outside of a scope, the codecs allocate from the heap as usual, so images that adopt the memory of the codec keep
+ * working. Everything allocated from the arena is discarded when the next scope on the thread starts, so the results
+ * of the codec must be copied out before then.
+ * */
+class DecodeArena final {
+ public:
+  /**
+   * @brief Makes the codecs allocate from the arena of the calling thread, until the scope is destroyed.
+   *
+   * @details If the previous scope needed more memory than the arena has, the arena is grown to fit it at the start
+   * of this one.
+   * */
+  class Scope final {
+   public:
+    Scope();
+
+    Scope(const Scope&) = delete;
+
+    ~Scope();
+
+    auto operator=(const Scope&) -> Scope& = delete;
+  };
+
+  [[nodiscard]] static auto Allocate(std::size_t size) -> void*;
+
+  [[nodiscard]] static auto Reallocate(void* ptr, std::size_t old_size, std::size_t new_size) -> void*;
+
+  /**
+   * @note Memory from the arena is only released when the next scope starts, and must not be freed after that. Other
+   * memory is released immediately.
+   * */
+  static void Free(void* ptr);
+};
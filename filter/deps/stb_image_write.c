@@ -1,2 +1,13 @@
+#include <stddef.h>
+
+/* Note: The encoder allocates from the decode arena of the pipeline, so that encoding frames does not allocate. */
+void* ad_decode_arena_malloc(size_t size);
+void* ad_decode_arena_realloc(void* ptr, size_t old_size, size_t new_size);
+void ad_decode_arena_free(void* ptr);
+
+#define STBIW_MALLOC(size) ad_decode_arena_malloc(size)
+#define STBIW_REALLOC_SIZED(ptr, old_size, new_size) ad_decode_arena_realloc(ptr, old_size, new_size)
+#define STBIW_FREE(ptr) ad_decode_arena_free(ptr)
+
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
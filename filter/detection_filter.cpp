@@ -4,12 +4,235 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <mutex>
 #include <opencv2/dnn.hpp>
-
+#include <opencv2/imgproc.hpp>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "buffer_pool.h"
 #include "exception.h"
+#include "inference_cache.h"
 
 namespace {
 
+/**
+ * @brief The last input that a forward pass was done on at a given position, along with the resulting output.
+ * */
+struct GateEntry final {
+  std::shared_ptr<Image> reference;
+
+  /**
+   * @brief The output of the forward pass, once it has been returned by the filter.
+   * */
+  NodeOutput output;
+
+  /**
+   * @brief Whether the forward pass is still in progress, in which case the output is not known yet.
+   * */
+  bool pending{};
+};
+
+/**
+ * @brief A copy of the network, along with the buffers used to run it.
+ *
+ * @note A network cannot be run from more than one thread at a time, so each replica is only ever used by one thread.
+ * */
+struct Replica final {
+  cv::dnn::Net net;
+
+  cv::Mat input_blob;
+};
+
+/**
+ * @brief A child output that is being processed, along with its result.
+ *
+ * @details The filter has one job for each output that may be in progress at once, and reuses them, so that
+ * scheduling a child output does not allocate.
+ * */
+struct Job final {
+  NodeOutput input;
+
+  /**
+   * @brief The key of the prediction in the cache, if there is one.
+   * */
+  InferenceKey key;
+
+  /**
+   * @brief The prediction that was found in the cache, or empty if the network has to be run.
+   * */
+  cv::Mat prediction;
+
+  /**
+   * @brief Whether the change gate skipped the forward pass, in which case the last output at the position of the
+   * tile is used instead.
+   * */
+  bool gated{};
+
+  NodeOutput output;
+
+  /**
+   * @brief The exception that the job ended with, which is rethrown once its result is requested.
+   * */
+  std::exception_ptr error;
+
+  bool done{};
+};
+
+/**
+ * @brief Runs jobs on a set of network replicas, with one thread per replica.
+ *
+ * @details Each thread takes the next job from a shared queue once its replica is idle. A pool with a single
+ * replica does not start a thread, and instead runs each job when its result is requested.
+ *
+ * @note The queue has a fixed capacity and the jobs are owned by the caller, so that submitting a job does not
+ * allocate.
+ * */
+class ReplicaPool final {
+ public:
+  using Function = std::function<void(Replica&, Job&)>;
+
+  /**
+   * @param function What to do with each job, which is called from the thread of the replica that runs it.
+   * @param capacity The most jobs that may be queued at once.
+   * */
+  ReplicaPool(std::vector<std::unique_ptr<Replica>> replicas, Function function, const std::size_t capacity)
+      : replicas_(std::move(replicas)), function_(std::move(function)), queue_(capacity) {
+    if (replicas_.size() > 1) {
+      for (auto& replica : replicas_) {
+        threads_.emplace_back(&ReplicaPool::Run, this, replica.get());
+      }
+    }
+  }
+
+  ReplicaPool(const ReplicaPool&) = delete;
+
+  ~ReplicaPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    condition_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  auto operator=(const ReplicaPool&) -> ReplicaPool& = delete;
+
+  [[nodiscard]] auto Size() const -> std::size_t { return replicas_.size(); }
+
+  /**
+   * @brief The first replica, which may only be used directly while no jobs are in progress.
+   * */
+  [[nodiscard]] auto Front() -> Replica& { return *replicas_.at(0); }
+
+  void Submit(Job& job) {
+    job.done = false;
+    job.error = nullptr;
+
+    if (threads_.empty()) {
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.at((queue_front_ + queue_size_) % queue_.size()) = &job;
+      queue_size_++;
+    }
+    condition_.notify_one();
+  }
+
+  /**
+   * @brief Waits for a job to finish, or runs it if the pool has no threads.
+   *
+   * @note The exception that the job ended with, if any, is rethrown.
+   * */
+  void Wait(Job& job) {
+    if (threads_.empty()) {
+      if (!job.done) {
+        Execute(*replicas_.at(0), job);
+        job.done = true;
+      }
+    } else {
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_condition_.wait(lock, [&job] { return job.done; });
+    }
+
+    if (job.error) {
+      std::rethrow_exception(std::exchange(job.error, nullptr));
+    }
+  }
+
+ protected:
+  void Run(Replica* replica) {
+    while (true) {
+      Job* job{};
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this] { return stopping_ || (queue_size_ > 0); });
+        // Note: Queued jobs are finished before stopping, since their results may still be waited on.
+        if (queue_size_ == 0) {
+          return;
+        }
+        job = queue_[queue_front_];
+        queue_front_ = (queue_front_ + 1) % queue_.size();
+        queue_size_--;
+      }
+      Execute(*replica, *job);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job->done = true;
+      }
+      done_condition_.notify_all();
+    }
+  }
+
+  void Execute(Replica& replica, Job& job) {
+    try {
+      function_(replica, job);
+    } catch (...) {
+      job.error = std::current_exception();
+    }
+  }
+
+ private:
+  std::vector<std::unique_ptr<Replica>> replicas_;
+
+  Function function_;
+
+  std::vector<std::thread> threads_;
+
+  std::mutex mutex_;
+
+  std::condition_variable condition_;
+
+  std::condition_variable done_condition_;
+
+  /**
+   * @brief A ring of the queued jobs.
+   * */
+  std::vector<Job*> queue_;
+
+  std::size_t queue_front_{};
+
+  std::size_t queue_size_{};
+
+  bool stopping_{false};
+};
+
 class DetectionFilterImpl final : public DetectionFilter {
  public:
   DetectionFilterImpl(std::unique_ptr<Node> child_node, const pipeline::DetectionFilterConfig& cfg)
@@ -18,48 +241,267 @@ class DetectionFilterImpl final : public DetectionFilter {
       throw Exception("Model path is empty.");
     }
 
-    if (config_.infill_width() == 0) {
+    if (!config_.full_frame() && (config_.infill_width() == 0)) {
       throw Exception("Infill width cannot be zero.");
     }
 
-    if (config_.infill_height() == 0) {
+    if (!config_.full_frame() && (config_.infill_height() == 0)) {
       throw Exception("Infill height cannot be zero.");
     }
 
+    if (config_.full_frame()) {
+      SPDLOG_INFO("Running network on whole frames.");
+    }
+
+    if (config_.threshold_score() == pipeline::ScoreKind::PERCENTILE) {
+      SPDLOG_INFO("Marking outputs as anomalous when the {} percentile exceeds {}.", Percentile(), config_.threshold());
+    } else {
+      SPDLOG_INFO("Marking outputs as anomalous when the {} score exceeds {}.",
+                  pipeline::ScoreKind_Name(config_.threshold_score()), config_.threshold());
+    }
+
+    if (config_.replicas() > 1) {
+      SPDLOG_INFO("Running {} replicas of the network.", config_.replicas());
+    }
+
+    if (config_.change_threshold() > 0.0F) {
+      SPDLOG_INFO("Skipping forward passes on tiles that changed by less than {} on average.",
+                  config_.change_threshold());
+    }
+
     SPDLOG_INFO("Infill location set to ({}, {}) with area of {}x{} and model path of '{}'.", config_.infill_x(),
                 config_.infill_y(), config_.infill_width(), config_.infill_height(), config_.model());
   }
 
   [[nodiscard]] auto Step() -> NodeOutput override {
-    auto child_output = child_node_->Step();
-    if (child_output.EndOfStream()) {
+    // Note: Enough child outputs are taken ahead of time to keep every replica busy. The results are returned in the
+    //       order that the child outputs were received in.
+    while (!end_of_stream_ && (num_pending_ < Window())) {
+      auto child_output = child_node_->Step();
+      if (child_output.EndOfStream()) {
+        if (num_gate_checks_ > 0) {
+          SPDLOG_INFO("Skipped {} of {} forward passes ({:.1f}%).", num_gated_, num_gate_checks_, SkipRate());
+        }
+        if (cache_) {
+          cache_->LogStats();
+        }
+        end_of_stream_ = true;
+        break;
+      }
+
+      if (!pool_) {
+        if (!LoadModel()) {
+          return NodeOutput();
+        }
+      }
+
+      Submit(std::move(child_output));
+    }
+
+    if (num_pending_ == 0) {
+      end_of_stream_ = false;
       return NodeOutput();
     }
 
-    if (!net_) {
-      if (!LoadModel()) {
-        return NodeOutput();
+    auto& job = jobs_[first_pending_];
+    first_pending_ = (first_pending_ + 1) % jobs_.size();
+    num_pending_--;
+    return Finish(job);
+  }
+
+  [[nodiscard]] auto Prepare() -> bool override {
+    if (!child_node_->Prepare()) {
+      return false;
+    }
+    return pool_ || LoadModel();
+  }
+
+  void Close() override { child_node_->Close(); }
+
+  [[nodiscard]] auto Plan(const std::array<std::uint32_t, 2>& frame_size) -> OutputPlan override {
+    const auto input = child_node_->Plan(frame_size);
+    const auto& shape = input.shape;
+
+    if ((shape.channels != 1) && (shape.channels != 3)) {
+      throw Exception("Detection filter needs 1 or 3 channels, but its input has " + std::to_string(shape.channels) +
+                      ".");
+    }
+
+    OutputPlan plan{shape, input.outputs_per_frame};
+
+    if (config_.full_frame()) {
+      if ((config_.infill_x() * 2 >= shape.width) || (config_.infill_y() * 2 >= shape.height)) {
+        throw Exception("Input of " + ShapeString(shape) + " is too small for a border of (" +
+                        std::to_string(config_.infill_x()) + ", " + std::to_string(config_.infill_y()) + ").");
+      }
+    } else {
+      const auto max_x = config_.infill_x() + config_.infill_width();
+      const auto max_y = config_.infill_y() + config_.infill_height();
+      if ((max_x > shape.width) || (max_y > shape.height)) {
+        throw Exception("Input of " + ShapeString(shape) + " is not large enough for infill (need " +
+                        std::to_string(max_x) + "x" + std::to_string(max_y) + ").");
       }
+      plan.shape.width = config_.infill_width();
+      plan.shape.height = static_cast<std::uint32_t>(config_.infill_height());
+    }
+
+    if (pool_) {
+      CheckModel(shape);
     }
 
-    return Process(child_output);
+    // Note: The change gate keeps the last output at each position, on top of the outputs that are in progress.
+    output_pool_->Reserve(plan.shape, plan.outputs_per_frame + Window() + 1, plan.shape);
+
+    return plan;
   }
 
  protected:
-  [[nodiscard]] auto LoadModel() -> bool {
-    net_.reset(new cv::dnn::Net(cv::dnn::readNetFromONNX(config_.model())));
+  /**
+   * @brief Checks whether a tile has changed enough since the last forward pass at its position to need another one.
+   *
+   * @return Whether the tile has not changed enough, in which case the output of the last forward pass at its position
+   * is used instead once the filter returns it.
+   * */
+  [[nodiscard]] auto Gate(const NodeOutput& child_output) -> bool {
+    if (child_output.frame_id != last_frame_id_) {
+      if (num_gate_checks_ > 0) {
+        SPDLOG_DEBUG("Skip rate is {:.1f}% after {} tiles.", SkipRate(), num_gate_checks_);
+      }
+      last_frame_id_ = child_output.frame_id;
+    }
+
+    num_gate_checks_++;
+
+    auto it = gate_.find(child_output.offset);
+    if (it == gate_.end()) {
+      return false;
+    }
+
+    // Note: A failed output must not stand in for later tiles, so its entry is dropped and the tile is processed.
+    if (!it->second.pending && !it->second.output.image) {
+      gate_.erase(it);
+      return false;
+    }
+
+    const auto& current = *child_output.image;
+    const auto& reference = *it->second.reference;
+    if ((current.Width() != reference.Width()) || (current.Height() != reference.Height()) ||
+        (current.Channels() != reference.Channels())) {
+      return false;
+    }
+
+    // Note: OpenCV has a vectorized implementation of the L1 norm, so the difference is computed with it.
+    const auto w = static_cast<int>(current.Width());
+    const auto h = static_cast<int>(current.Height());
+    const auto channels = static_cast<int>(current.Channels());
+    const auto type = CV_8UC(channels);
+    const cv::Mat current_mat(h, w, type, const_cast<std::uint8_t*>(current.Data()), current.Stride());
+    const cv::Mat reference_mat(h, w, type, const_cast<std::uint8_t*>(reference.Data()), reference.Stride());
+    const auto sad = cv::norm(current_mat, reference_mat, cv::NORM_L1);
+    const auto change = sad / (static_cast<double>(w) * static_cast<double>(h) * channels);
+    if (change >= config_.change_threshold()) {
+      return false;
+    }
+
+    num_gated_++;
+
+    return true;
+  }
+
+  [[nodiscard]] static auto ShapeString(const ImageShape& shape) -> std::string {
+    return std::to_string(shape.width) + "x" + std::to_string(shape.height) + "x" + std::to_string(shape.channels);
+  }
+
+  /**
+   * @brief Runs the network once on a blank input, to check that its prediction fits the configuration.
+   *
+   * @details This also does the allocations that the network does on its first forward pass.
+   * */
+  void CheckModel(const ImageShape& input_shape) {
+    auto input = std::make_shared<Image>(input_shape);
+    std::memset(input->Data(), 0, input->Stride() * input->Height());
+
+    NodeOutput blank(input, 0);
+
+    cv::Mat prediction;
+
+    // Note: No jobs are in progress while the filter is planned, so the first replica can be used directly.
+    try {
+      prediction = Forward(pool_->Front(), blank);
+    } catch (const cv::Exception& e) {
+      throw Exception("Model '" + config_.model() + "' failed to run on an input of " + ShapeString(input_shape) +
+                      ": " + e.what());
+    }
+
+    if (prediction.empty()) {
+      throw Exception("Model '" + config_.model() + "' failed to run on an input of " + ShapeString(input_shape) + ".");
+    }
+
+    if (prediction.channels() != static_cast<int>(input_shape.channels)) {
+      throw Exception("Model '" + config_.model() + "' predicts " + std::to_string(prediction.channels()) +
+                      " channels, but its input has " + std::to_string(input_shape.channels) + ".");
+    }
+
+    if (!config_.full_frame() && !CheckOutputShape(prediction)) {
+      throw Exception("Model '" + config_.model() + "' does not predict the configured infill size.");
+    }
+  }
+
+  [[nodiscard]] auto SkipRate() const -> double {
+    return (num_gate_checks_ == 0) ? 0.0 : (100.0 * num_gated_ / num_gate_checks_);
+  }
+
+  [[nodiscard]] auto Window() const -> std::size_t { return pool_ ? pool_->Size() : 1; }
 
-    if (net_->empty()) {
-      SPDLOG_ERROR("Failed to load model '{}'.", config_.model());
+  [[nodiscard]] auto LoadModel() -> bool {
+    // Note: OpenCV cannot share weights between networks, but the model file is only read once and each replica is
+    //       parsed from the same buffer.
+    std::ifstream file(config_.model(), std::ios::binary);
+    const std::vector<char> model_data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (model_data.empty()) {
+      SPDLOG_ERROR("Failed to read model '{}'.", config_.model());
       return false;
     }
 
+    const auto num_replicas = std::max(config_.replicas(), 1u);
+
+    std::vector<std::unique_ptr<Replica>> replicas;
+
+    for (std::uint32_t i = 0; i < num_replicas; i++) {
+      auto replica = std::make_unique<Replica>();
+      try {
+        replica->net = cv::dnn::readNetFromONNX(model_data.data(), model_data.size());
+      } catch (const cv::Exception& e) {
+        SPDLOG_ERROR("Failed to parse model '{}': {}", config_.model(), e.what());
+        return false;
+      }
+      if (replica->net.empty()) {
+        SPDLOG_ERROR("Failed to load model '{}'.", config_.model());
+        return false;
+      }
+      replicas.emplace_back(std::move(replica));
+    }
+
+    jobs_.resize(replicas.size());
+    pool_ = std::make_unique<ReplicaPool>(
+        std::move(replicas), [this](Replica& replica, Job& job) { Run(replica, job); }, jobs_.size());
+
     SPDLOG_INFO("Loaded model '{}'.", config_.model());
 
+    if (config_.has_cache() && ((config_.cache().memory_capacity() > 0) || !config_.cache().path().empty())) {
+      // Note: The bytes that were parsed are hashed, so the hash matches the loaded model even if the file changes.
+      const auto model_hash = InferenceCache::Hash(model_data.data(), model_data.size());
+      if (cache_) {
+        cache_->SetModel(model_hash);
+      } else {
+        cache_ = std::make_unique<InferenceCache>(config_.cache(), model_hash);
+      }
+    }
+
     return true;
   }
 
-  [[nodiscard]] auto CheckShape(const NodeOutput& child_output) -> bool {
+  [[nodiscard]] auto CheckShape(const NodeOutput& child_output) const -> bool {
     const auto w = child_output.image->Width();
     const auto h = child_output.image->Height();
 
@@ -74,12 +516,27 @@ class DetectionFilterImpl final : public DetectionFilter {
     return true;
   }
 
-  [[nodiscard]] auto CreateInput(Image& img) -> cv::Mat {
-    cv::Mat input(img.Height(), img.Width(), CV_8UC3, img.Data());
-    return cv::dnn::blobFromImage(input, 1.0 / 255.0);
+  /**
+   * @brief Creates the network input of a child output.
+   *
+   * @details If the child output carries a tensor, it is already in the layout of the network input and is used
+   * without being copied. Otherwise, the image is converted.
+   * */
+  static void CreateInput(const NodeOutput& child_output, cv::Mat& blob) {
+    if (child_output.tensor) {
+      auto& tensor = *child_output.tensor;
+      const int shape[4]{1, static_cast<int>(tensor.Channels()), static_cast<int>(tensor.Height()),
+                         static_cast<int>(tensor.Width())};
+      blob = cv::Mat(4, shape, CV_32F, tensor.Data());
+      return;
+    }
+
+    auto& img = *child_output.image;
+    cv::Mat input(img.Height(), img.Width(), CV_8UC(static_cast<int>(img.Channels())), img.Data(), img.Stride());
+    cv::dnn::blobFromImage(input, blob, 1.0 / 255.0);
   }
 
-  [[nodiscard]] auto CheckOutputShape(const cv::Mat& output) -> bool {
+  [[nodiscard]] auto CheckOutputShape(const cv::Mat& output) const -> bool {
     if ((output.rows != config_.infill_height()) || (output.cols != config_.infill_width())) {
       SPDLOG_ERROR("Expected output size of {}x{} but got {}x{}", config_.infill_width(), config_.infill_height(),
                    output.cols, output.rows);
@@ -94,56 +551,310 @@ class DetectionFilterImpl final : public DetectionFilter {
     return x * x;
   }
 
-  [[nodiscard]] auto CreateOutput(const NodeOutput& child_output, cv::Mat& output) -> NodeOutput {
-    auto detection_output = std::make_shared<Image>(output.rows, output.cols);
+  /**
+   * @brief Writes the scaled squared error between a prediction and the measured pixels into a residual image.
+   *
+   * @param measured The image that was given to the network, or the 8-bit image of the tensor that was, in the range
+   * of the prediction times 255.
+   * @param measured_x The column of the measured image that the first predicted column corresponds to.
+   * @param measured_y The row of the measured image that the first predicted row corresponds to.
+   * @param predicted The floating point prediction of the network, with the same number of channels as the measured
+   * image.
+   * @param residual The image to write the residual to.
+   * @param residual_x The column in the residual image to write the first predicted column to.
+   * @param residual_y The row in the residual image to write the first predicted row to.
+   * @param histogram The histogram to add the residual of each pixel to.
+   * */
+  static void ComputeResidual(const Image& measured, const std::uint32_t measured_x, const std::uint32_t measured_y,
+                              const cv::Mat& predicted, Image& residual, const std::uint32_t residual_x,
+                              const std::uint32_t residual_y, ResidualHistogram& histogram) {
+    // Note: The channel count is a template parameter so that the inner loop is unrolled for the supported layouts.
+    if (measured.Channels() == 1) {
+      ComputeResidual<1>(measured, measured_x, measured_y, predicted, residual, residual_x, residual_y, histogram);
+    } else {
+      ComputeResidual<3>(measured, measured_x, measured_y, predicted, residual, residual_x, residual_y, histogram);
+    }
+  }
 
-    const auto num_pixels = output.rows * output.cols;
+  template <std::uint32_t Channels>
+  static void ComputeResidual(const Image& measured, const std::uint32_t measured_x, const std::uint32_t measured_y,
+                              const cv::Mat& predicted, Image& residual, const std::uint32_t residual_x,
+                              const std::uint32_t residual_y, ResidualHistogram& histogram) {
+    for (auto y = 0; y < predicted.rows; y++) {
+      const auto* predicted_row = predicted.ptr<float>(y);
 
-    const auto* input = child_output.image->Data();
-    const auto input_w = child_output.image->Width();
+      const auto* input = measured.Row(measured_y + y) + measured_x * Channels;
 
-    for (auto i = 0; i < num_pixels; i++) {
-      const auto x = i % output.cols;
-      const auto y = i / output.cols;
+      auto* output = residual.Row(residual_y + y) + residual_x * Channels;
 
-      const auto predicted = output.at<std::array<float, 3>>(i);
-      const auto predicted_r = predicted[0] * 255.0F;
-      const auto predicted_g = predicted[1] * 255.0F;
-      const auto predicted_b = predicted[2] * 255.0F;
+      for (auto x = 0; x < predicted.cols; x++) {
+        std::uint8_t pixel_max{};
 
-      const auto in_offset = ((config_.infill_y() + y) * input_w + (config_.infill_x() + x)) * 3;
+        for (std::uint32_t c = 0; c < Channels; c++) {
+          const auto predicted_value = predicted_row[x * Channels + c] * 255.0F;
+          const auto measured_value = static_cast<float>(input[x * Channels + c]);
 
-      const auto measured_r = static_cast<float>(input[in_offset + 0]);
-      const auto measured_g = static_cast<float>(input[in_offset + 1]);
-      const auto measured_b = static_cast<float>(input[in_offset + 2]);
+          constexpr auto scale{1.0F / 255.0F};
+          const auto delta = static_cast<int>(Square(predicted_value - measured_value) * scale);
 
-      constexpr auto scale{1.0F / 255.0F};
-      const auto delta_r = static_cast<int>(Square(predicted_r - measured_r) * scale);
-      const auto delta_g = static_cast<int>(Square(predicted_g - measured_g) * scale);
-      const auto delta_b = static_cast<int>(Square(predicted_b - measured_b) * scale);
+          const auto out = static_cast<std::uint8_t>(std::clamp(delta, 0, 255));
+          output[x * Channels + c] = out;
+          pixel_max = std::max(pixel_max, out);
+        }
 
-      auto* out = detection_output->Data() + i * 3;
-      out[0] = static_cast<std::uint8_t>(std::clamp(delta_r, 0, 255));
-      out[1] = static_cast<std::uint8_t>(std::clamp(delta_g, 0, 255));
-      out[2] = static_cast<std::uint8_t>(std::clamp(delta_b, 0, 255));
+        histogram[pixel_max]++;
+      }
     }
+  }
+
+  [[nodiscard]] auto Percentile() const -> float {
+    return (config_.score_percentile() == 0.0F) ? 99.0F : std::clamp(config_.score_percentile(), 0.0F, 100.0F);
+  }
+
+  [[nodiscard]] auto ComputeScores(const ResidualHistogram& histogram) const -> AnomalyScores {
+    auto scores = AnomalyScores::FromHistogram(histogram, Percentile());
+
+    switch (config_.threshold_score()) {
+      case pipeline::ScoreKind::MEAN:
+        scores.anomalous = scores.mean > config_.threshold();
+        break;
+      case pipeline::ScoreKind::MAX:
+        scores.anomalous = scores.max > config_.threshold();
+        break;
+      case pipeline::ScoreKind::PERCENTILE:
+        scores.anomalous = scores.percentile > config_.threshold();
+        break;
+    }
+
+    return scores;
+  }
+
+  [[nodiscard]] auto CreateOutput(const NodeOutput& child_output, const cv::Mat& output) const -> NodeOutput {
+    const auto& input = *child_output.image;
+
+    const ImageShape output_shape{static_cast<std::uint32_t>(output.cols), static_cast<std::uint32_t>(output.rows),
+                                  input.Channels(), input.Format()};
+
+    auto detection_output = output_pool_->Acquire(output_shape, output_shape);
+
+    ResidualHistogram histogram{};
+
+    ComputeResidual(*child_output.image, config_.infill_x(), config_.infill_y(), output, *detection_output, 0, 0,
+                    histogram);
 
     NodeOutput self_output(detection_output, child_output.frame_id);
     self_output.offset[0] = child_output.offset[0] + config_.infill_x();
     self_output.offset[1] = child_output.offset[1] + config_.infill_y();
     self_output.size = child_output.size;
+    self_output.sequence = child_output.sequence;
+    self_output.times = child_output.times;
+    self_output.times.Mark(Stage::kDetect);
+    self_output.scores = ComputeScores(histogram);
     return self_output;
   }
 
-  [[nodiscard]] auto Process(const NodeOutput& child_output) -> NodeOutput {
-    if (!CheckShape(child_output)) {
+  /**
+   * @brief Creates a residual with the size of the input image from a fully convolutional forward pass.
+   *
+   * @details The network consumes a border of the input on each side with its valid convolutions, so the prediction
+   * only covers the interior of the image. The border is taken to be the infill offset on all sides. If the network
+   * also downsamples, the prediction is resampled to the size of the interior before it is compared. The border of
+   * the residual is left as zero.
+   * */
+  [[nodiscard]] auto CreateFrameOutput(const NodeOutput& child_output, const cv::Mat& output) const -> NodeOutput {
+    const auto w = child_output.image->Width();
+    const auto h = child_output.image->Height();
+    const auto inner_w = static_cast<int>(w - config_.infill_x() * 2);
+    const auto inner_h = static_cast<int>(h - config_.infill_y() * 2);
+
+    cv::Mat prediction = output;
+    if ((output.cols != inner_w) || (output.rows != inner_h)) {
+      cv::resize(output, prediction, cv::Size(inner_w, inner_h), 0, 0, cv::INTER_LINEAR);
+    }
+
+    const auto output_shape = child_output.image->Shape();
+
+    auto detection_output = output_pool_->Acquire(output_shape, output_shape);
+    std::memset(detection_output->Data(), 0, detection_output->Stride() * h);
+
+    ResidualHistogram histogram{};
+
+    ComputeResidual(*child_output.image, config_.infill_x(), config_.infill_y(), prediction, *detection_output,
+                    config_.infill_x(), config_.infill_y(), histogram);
+
+    NodeOutput self_output(detection_output, child_output);
+    self_output.times.Mark(Stage::kDetect);
+    self_output.scores = ComputeScores(histogram);
+    return self_output;
+  }
+
+  [[nodiscard]] auto CheckFrameShape(const NodeOutput& child_output) const -> bool {
+    const auto w = child_output.image->Width();
+    const auto h = child_output.image->Height();
+
+    if ((config_.infill_x() * 2 >= w) || (config_.infill_y() * 2 >= h)) {
+      SPDLOG_ERROR("Frame of {}x{} is too small for a border of ({}, {}).", w, h, config_.infill_x(),
+                   config_.infill_y());
+      return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief Schedules the processing of a child output in the next free job.
+   *
+   * @details The gate and the cache are checked here, in the order that the child outputs are received, so that the
+   * jobs run by the replicas only have to do the forward pass and compute the residual.
+   * */
+  void Submit(NodeOutput child_output) {
+    auto& job = jobs_[(first_pending_ + num_pending_) % jobs_.size()];
+    num_pending_++;
+
+    job.input = std::move(child_output);
+    job.gated = (config_.change_threshold() > 0.0F) && Gate(job.input);
+    if (job.gated) {
+      return;
+    }
+
+    if (config_.change_threshold() > 0.0F) {
+      auto& entry = gate_[job.input.offset];
+      entry.reference = job.input.image;
+      entry.output = NodeOutput();
+      entry.pending = true;
+    }
+
+    Schedule(job);
+  }
+
+  /**
+   * @brief Looks up the prediction of a job in the cache, and queues it to create its residual.
+   * */
+  void Schedule(Job& job) {
+    job.prediction.release();
+
+    if (cache_) {
+      const auto& child_output = job.input;
+      job.key.model_hash = cache_->ModelHash();
+      job.key.content_hash = child_output.tensor ? InferenceCache::Hash(*child_output.tensor)
+                                                 : InferenceCache::Hash(*child_output.image);
+      job.key.infill = {config_.infill_x(), config_.infill_y(), config_.infill_width(),
+                        static_cast<std::uint32_t>(config_.infill_height())};
+      job.prediction = cache_->Find(job.key);
+    }
+
+    pool_->Submit(job);
+  }
+
+  /**
+   * @brief Waits for the result of a job, and frees the job for the next child output.
+   *
+   * @details The previous output at the position of a gated tile is only known once it has been returned, which it
+   * has by now since outputs are returned in order. If it turns out to have failed, the tile is processed after all.
+   * */
+  [[nodiscard]] auto Finish(Job& job) -> NodeOutput {
+    NodeOutput output;
+
+    if (job.gated) {
+      const auto it = gate_.find(job.input.offset);
+      if ((it != gate_.end()) && it->second.output.image) {
+        output = it->second.output;
+        output.frame_id = job.input.frame_id;
+        output.sequence = job.input.sequence;
+        output.times = job.input.times;
+        output.times.Mark(Stage::kDetect);
+        Release(job);
+        return output;
+      }
+      num_gated_--;
+      job.gated = false;
+      Schedule(job);
+    }
+
+    pool_->Wait(job);
+    output = std::move(job.output);
+
+    // Note: Only the job that set the reference of a position completes it, since a gated tile that was processed
+    //       after all did not.
+    if (config_.change_threshold() > 0.0F) {
+      const auto it = gate_.find(job.input.offset);
+      if ((it != gate_.end()) && (it->second.reference == job.input.image)) {
+        it->second.output = output;
+        it->second.pending = false;
+      }
+    }
+
+    Release(job);
+    return output;
+  }
+
+  /**
+   * @brief Drops the buffers that a job refers to, so that they return to their pools.
+   * */
+  static void Release(Job& job) {
+    job.input = NodeOutput();
+    job.output = NodeOutput();
+    job.prediction.release();
+  }
+
+  /**
+   * @brief Runs a job on a replica.
+   *
+   * @note This may be called from the thread of any replica.
+   * */
+  void Run(Replica& replica, Job& job) { job.output = Process(replica, job.input, job.key, job.prediction); }
+
+  /**
+   * @brief Creates the residual of a child output, running the network unless a cached prediction is given.
+   *
+   * @note This may be called from the thread of any replica.
+   * */
+  [[nodiscard]] auto Process(Replica& replica, const NodeOutput& child_output, const InferenceKey& key,
+                             cv::Mat prediction) -> NodeOutput {
+    const auto full_frame = config_.full_frame();
+
+    if (!(full_frame ? CheckFrameShape(child_output) : CheckShape(child_output))) {
+      return NodeOutput();
+    }
+
+    if (prediction.empty()) {
+      prediction = Forward(replica, child_output);
+      if (prediction.empty()) {
+        return NodeOutput();
+      }
+      if (cache_) {
+        cache_->Insert(key, prediction);
+      }
+    }
+
+    if (prediction.channels() != static_cast<int>(child_output.image->Channels())) {
+      SPDLOG_ERROR("Expected a prediction with {} channels but got {}.", child_output.image->Channels(),
+                   prediction.channels());
+      return NodeOutput();
+    }
+
+    if (full_frame) {
+      return CreateFrameOutput(child_output, prediction);
+    }
+
+    if (!CheckOutputShape(prediction)) {
       return NodeOutput();
     }
-    auto input_blob = CreateInput(*child_output.image);
 
-    net_->setInput(input_blob);
+    return CreateOutput(child_output, prediction);
+  }
 
-    auto output_blob = net_->forward();
+  /**
+   * @brief Runs the network of a replica on the input of a child output.
+   *
+   * @return The prediction, or an empty matrix if the forward pass failed.
+   * */
+  [[nodiscard]] static auto Forward(Replica& replica, const NodeOutput& child_output) -> cv::Mat {
+    CreateInput(child_output, replica.input_blob);
+
+    replica.net.setInput(replica.input_blob);
+
+    auto output_blob = replica.net.forward();
 
     std::vector<cv::Mat> outputs;
 
@@ -151,16 +862,12 @@ class DetectionFilterImpl final : public DetectionFilter {
 
     if (outputs.empty()) {
       SPDLOG_ERROR("Forward pass did not produce any outputs.");
-      return NodeOutput();
-    }
-
-    if (!CheckOutputShape(outputs[0])) {
-      return NodeOutput();
+      return cv::Mat();
     }
 
     SPDLOG_INFO("Completed forward pass.");
 
-    return CreateOutput(child_output, outputs.at(0));
+    return outputs[0];
   }
 
  private:
@@ -168,7 +875,33 @@ class DetectionFilterImpl final : public DetectionFilter {
 
   pipeline::DetectionFilterConfig config_;
 
-  std::unique_ptr<cv::dnn::Net> net_;
+  std::unique_ptr<InferenceCache> cache_;
+
+  /**
+   * @brief The jobs, of which the ones in progress form a ring that starts at @ref first_pending_.
+   * */
+  std::vector<Job> jobs_;
+
+  std::size_t first_pending_{};
+
+  std::size_t num_pending_{};
+
+  bool end_of_stream_{false};
+
+  std::map<std::array<std::uint32_t, 2>, GateEntry> gate_;
+
+  std::uint32_t last_frame_id_{std::numeric_limits<std::uint32_t>::max()};
+
+  std::uint64_t num_gate_checks_{};
+
+  std::uint64_t num_gated_{};
+
+  /**
+   * @note This is declared last so that it is destroyed first, since its jobs refer to the other members.
+   * */
+  std::shared_ptr<ImagePool> output_pool_{ImagePool::Create()};
+
+  std::unique_ptr<ReplicaPool> pool_;
 };
 
 }  // namespace
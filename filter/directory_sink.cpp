@@ -2,21 +2,30 @@
 
 #include <stb_image_write.h>
 
+#include <chrono>
 #include <cstddef>
 #include <filesystem>
 #include <iomanip>
 #include <sstream>
 
+#include "latency_tracker.h"
+
 namespace {
 
 class DirectorySinkImpl final : public DirectorySink {
  public:
   DirectorySinkImpl(std::unique_ptr<Node> child, const pipeline::DirectorySinkConfig& cfg)
-      : child_(std::move(child)), config_(cfg) {}
+      : child_(std::move(child)),
+        config_(cfg),
+        latency_("directory sink '" + cfg.path() + "'", std::chrono::milliseconds(cfg.latency_report_interval_ms())) {}
 
   auto Step() -> NodeOutput override {
     auto output = child_->Step();
     if (output.EndOfStream()) {
+      latency_.Report();
+      return output;
+    }
+    if (config_.anomalous_only() && !(output.scores && output.scores->anomalous)) {
       return output;
     }
     std::ostringstream name_stream;
@@ -27,15 +36,29 @@ class DirectorySinkImpl final : public DirectorySink {
 
     image_index_++;
 
+    output.times.Mark(Stage::kSink);
+
+    latency_.Record(output.times);
+
     return output;
   }
 
+  [[nodiscard]] auto Prepare() -> bool override { return child_->Prepare(); }
+
+  void Close() override { child_->Close(); }
+
+  [[nodiscard]] auto Plan(const std::array<std::uint32_t, 2>& frame_size) -> OutputPlan override {
+    return child_->Plan(frame_size);
+  }
+
  private:
   std::unique_ptr<Node> child_;
 
   pipeline::DirectorySinkConfig config_;
 
   std::size_t image_index_{};
+
+  LatencyTracker latency_;
 };
 
 }  // namespace
@@ -1,16 +1,25 @@
 #include "directory_source.h"
 
 #include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <fstream>
 #include <limits>
 
+#include "buffer_pool.h"
 #include "image.h"
 
 namespace {
 
+/**
+ * @brief The number of frames that are reserved: the one being decoded, one queued by a load shedder, and the ones
+ * that downstream nodes still hold.
+ * */
+constexpr std::size_t reserved_frames{4};
+
 class DirectorySourceImpl final : public DirectorySource {
  public:
-  DirectorySourceImpl(const pipeline::DirectorySourceConfig& cfg) {
+  DirectorySourceImpl(const pipeline::DirectorySourceConfig& cfg, const PixelFormat format) : format_(format) {
     const std::filesystem::path path{cfg.path().empty() ? std::string(".")
                                                         : cfg.path()};
 
@@ -22,12 +31,19 @@ class DirectorySourceImpl final : public DirectorySource {
   }
 
   auto Step() -> NodeOutput override {
-    auto img = std::make_shared<Image>();
+    if (closed_) {
+      return NodeOutput();
+    }
+
+    std::shared_ptr<Image> img;
 
     auto id{std::numeric_limits<std::uint32_t>::max()};
 
     for (auto i = offset_; i < paths_.size(); i++) {
-      if (img->Load(paths_[offset_].c_str())) {
+      if (ReadFile(paths_[i])) {
+        img = DecodePooled(*frame_pool_, file_data_.data(), file_data_.size(), format_);
+      }
+      if (img) {
         offset_ = (i + 1);
         id = i;
         break;
@@ -36,19 +52,55 @@ class DirectorySourceImpl final : public DirectorySource {
 
     // Note: If all images fail to load or there are no images in the directory,
     // we may end up here with an empty image.
+    if (!img) {
+      img = std::make_shared<Image>();
+    }
+
+    auto output = NodeOutput(img, id);
+    output.times.Mark(Stage::kReceive);
+    return output;
+  }
+
+  void Close() override { closed_ = true; }
 
-    return NodeOutput(img, id);
+  [[nodiscard]] auto Plan(const std::array<std::uint32_t, 2>& frame_size) -> OutputPlan override {
+    const ImageShape shape{frame_size[0], frame_size[1], Image::FormatChannels(format_), format_};
+    frame_pool_->Reserve(shape, reserved_frames, shape);
+    return OutputPlan{shape, 1};
+  }
+
+ protected:
+  /**
+   * @brief Reads a file into @ref file_data_, which keeps its capacity between files.
+   * */
+  [[nodiscard]] auto ReadFile(const std::string& path) -> bool {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+      return false;
+    }
+    const auto size = static_cast<std::streamsize>(file.tellg());
+    file.seekg(0);
+    file_data_.resize(static_cast<std::size_t>(std::max<std::streamsize>(size, 0)));
+    return static_cast<bool>(file.read(file_data_.data(), size));
   }
 
  private:
   std::vector<std::string> paths_;
 
   std::size_t offset_{};
+
+  PixelFormat format_{PixelFormat::kRgb8};
+
+  std::shared_ptr<ImagePool> frame_pool_{ImagePool::Create()};
+
+  std::vector<char> file_data_;
+
+  std::atomic<bool> closed_{};
 };
 
 }  // namespace
 
-auto DirectorySource::Create(const pipeline::DirectorySourceConfig& cfg)
+auto DirectorySource::Create(const pipeline::DirectorySourceConfig& cfg, const PixelFormat format)
     -> std::unique_ptr<DirectorySource> {
-  return std::make_unique<DirectorySourceImpl>(cfg);
+  return std::make_unique<DirectorySourceImpl>(cfg, format);
 }
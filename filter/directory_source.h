@@ -8,7 +8,10 @@
 
 class DirectorySource : public Node {
  public:
-  static auto Create(const pipeline::DirectorySourceConfig& cfg)
+  /**
+   * @param format The format to decode images to.
+   * */
+  static auto Create(const pipeline::DirectorySourceConfig& cfg, PixelFormat format)
       -> std::unique_ptr<DirectorySource>;
 
   ~DirectorySource() override = default;
@@ -1,10 +1,13 @@
 #include "frame_builder.h"
 
+#include <algorithm>
 #include <optional>
 #include <vector>
 
 #include <cstring>
 
+#include "buffer_pool.h"
+
 namespace {
 
 class FrameBuilderImpl final : public FrameBuilder {
@@ -30,11 +33,14 @@ class FrameBuilderImpl final : public FrameBuilder {
       }
 
       if (!self_output) {
-        self_output =
-            NodeOutput(std::make_shared<Image>(child_output.size[0], child_output.size[1]), child_output.frame_id);
+        const ImageShape frame_shape{child_output.size[0], child_output.size[1], child_output.image->Channels(),
+                                     child_output.image->Format()};
+        self_output = NodeOutput(frame_pool_->Acquire(frame_shape, frame_shape), child_output.frame_id);
         self_output->offset[0] = 0;
         self_output->offset[1] = 0;
-        std::memset(self_output->image->Data(), 0, self_output->image->Width() * self_output->image->Height() * 3);
+        self_output->sequence = child_output.sequence;
+        // Note: Areas that no tile covers, such as those outside of a region of interest, are left as zero.
+        std::memset(self_output->image->Data(), 0, self_output->image->Stride() * self_output->image->Height());
       } else if (self_output->frame_id != child_output.frame_id) {
         // The child node has finished the current frame and moved to the next.
         // Queue the child output for the next frame and return the completed frame to the parent node.
@@ -46,23 +52,79 @@ class FrameBuilderImpl final : public FrameBuilder {
 
       const auto& tile = *child_output.image;
 
-      for (auto y = 0; y < tile.Height(); y++) {
-        const auto dst_offset = (((y + child_output.offset[1]) * frame.Width()) + child_output.offset[0]) * 3;
-        std::memcpy(frame.Data() + dst_offset, tile.Data() + y * tile.Width() * 3, 3 * tile.Width());
+      for (std::uint32_t y = 0; y < tile.Height(); y++) {
+        auto* dst = frame.Row(y + child_output.offset[1]) + child_output.offset[0] * frame.PixelSize();
+        std::memcpy(dst, tile.Row(y), tile.RowSize());
+      }
+
+      if (child_output.scores) {
+        MergeScores(*self_output, *child_output.scores);
       }
+
+      // Note: The frame takes the times of its last tile, since the frame is only complete once that tile is.
+      self_output->times = child_output.times;
     }
 
     if (!self_output) {
       return NodeOutput();
     }
 
+    if (self_output->scores) {
+      auto& scores = *self_output->scores;
+      const auto anomalous = scores.anomalous;
+      scores = AnomalyScores::FromHistogram(scores.histogram, scores.percentile_rank);
+      scores.anomalous = anomalous;
+    }
+
+    self_output->times.Mark(Stage::kBuild);
+
     return self_output.value();
   }
 
+  [[nodiscard]] auto Prepare() -> bool override { return child_node_->Prepare(); }
+
+  void Close() override { child_node_->Close(); }
+
+  [[nodiscard]] auto Plan(const std::array<std::uint32_t, 2>& frame_size) -> OutputPlan override {
+    const auto input = child_node_->Plan(frame_size);
+
+    const ImageShape frame_shape{frame_size[0], frame_size[1], input.shape.channels, input.shape.format};
+
+    // Note: One frame is built while the previous one may still be held by the parent node.
+    frame_pool_->Reserve(frame_shape, 2, frame_shape);
+
+    child_outputs_.reserve(1);
+
+    return OutputPlan{frame_shape, 1};
+  }
+
+ protected:
+  /**
+   * @brief Combines the scores of a tile into the scores of the frame.
+   *
+   * @details Only the residuals are added up here. Once the frame is complete, its scores are computed from them as if
+   * the frame were one residual image. The frame is anomalous if any of its tiles are, since the threshold is only
+   * known to the detection filter.
+   * */
+  static void MergeScores(NodeOutput& frame_output, const AnomalyScores& tile_scores) {
+    if (!frame_output.scores) {
+      frame_output.scores = tile_scores;
+      return;
+    }
+
+    auto& scores = *frame_output.scores;
+    for (std::size_t i = 0; i < scores.histogram.size(); i++) {
+      scores.histogram[i] += tile_scores.histogram[i];
+    }
+    scores.anomalous = scores.anomalous || tile_scores.anomalous;
+  }
+
  private:
   std::vector<NodeOutput> child_outputs_;
 
   std::unique_ptr<Node> child_node_;
+
+  std::shared_ptr<ImagePool> frame_pool_{ImagePool::Create()};
 };
 
 }  // namespace
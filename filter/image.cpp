@@ -3,53 +3,187 @@
 #include <stb_image.h>
 #include <stb_image_write.h>
 
+#include <atomic>
 #include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
 
-Image::Image(const uint32_t w, const uint32_t h) noexcept : data_(static_cast<uint8_t*>(std::malloc(w * h * 3))) {
-  if (data_) {
-    width_ = w;
-    height_ = h;
+#include "decode_arena.h"
+
+namespace {
+
+[[nodiscard]] auto AlignUp(const std::size_t size, const std::size_t alignment) -> std::size_t {
+  return ((size + alignment - 1) / alignment) * alignment;
+}
+
+std::atomic<std::uint64_t> num_allocations{0};
+
+void FreeStbImage(uint8_t* data) { stbi_image_free(data); }
+
+void FreeAligned(uint8_t* data) { std::free(data); }
+
+[[nodiscard]] auto IsDecodable(const PixelFormat format) -> bool {
+  return (format == PixelFormat::kGray8) || (format == PixelFormat::kRgb8);
+}
+
+}  // namespace
+
+Image::Image(const uint32_t w, const uint32_t h, const PixelFormat format, const uint32_t channels) noexcept {
+  const auto num_channels = (channels == 0) ? FormatChannels(format) : channels;
+  const auto stride = AlignUp(static_cast<std::size_t>(w) * num_channels * FormatChannelSize(format), alignment);
+  const auto size = stride * h;
+  if (size == 0) {
+    return;
+  }
+  auto* data = static_cast<uint8_t*>(std::aligned_alloc(alignment, size));
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (data) {
+    Adopt(w, h, format, num_channels, stride, data, FreeAligned);
   }
 }
 
-Image::~Image() {
-  if (data_) {
-    stbi_image_free(data_);
+Image::Image(const uint32_t w, const uint32_t h, const PixelFormat format, const uint32_t channels,
+             const std::size_t stride, uint8_t* data, Deleter deleter) noexcept {
+  Adopt(w, h, format, channels, stride, data, std::move(deleter));
+}
+
+auto Image::NumAllocations() -> std::uint64_t { return num_allocations.load(std::memory_order_relaxed); }
+
+auto Image::FormatChannels(const PixelFormat format) -> uint32_t {
+  switch (format) {
+    case PixelFormat::kGray8:
+      return 1;
+    case PixelFormat::kRgb8:
+    case PixelFormat::kBgr8:
+    case PixelFormat::kFloat32:
+      break;
   }
+  return 3;
 }
 
-auto Image::Load(const char* path) -> bool {
+auto Image::FormatChannelSize(const PixelFormat format) -> uint32_t {
+  return (format == PixelFormat::kFloat32) ? sizeof(float) : 1;
+}
+
+auto Image::Load(const char* path, const PixelFormat format) -> bool {
+  if (!IsDecodable(format)) {
+    return false;
+  }
+
+  const auto channels = FormatChannels(format);
+
   int w{};
   int h{};
-  auto* data = stbi_load(path, &w, &h, nullptr, 3);
+  auto* data = stbi_load(path, &w, &h, nullptr, static_cast<int>(channels));
   if (!data) {
     return false;
   }
 
-  if (data_) {
-    stbi_image_free(data_);
-  }
-  data_ = data;
-  width_ = static_cast<uint32_t>(w);
-  height_ = static_cast<uint32_t>(h);
+  Adopt(static_cast<uint32_t>(w), static_cast<uint32_t>(h), format, channels, static_cast<std::size_t>(w) * channels,
+        data, FreeStbImage);
   return true;
 }
 
-auto Image::LoadFromMemory(const void* data, const std::size_t size) -> bool {
+auto Image::LoadFromMemory(const void* data, const std::size_t size, const PixelFormat format) -> bool {
+  if (!IsDecodable(format)) {
+    return false;
+  }
+
+  const auto channels = FormatChannels(format);
+
   int w{};
   int h{};
-  auto* ptr = stbi_load_from_memory(static_cast<const stbi_uc*>(data), size, &w, &h, nullptr, 3);
+  auto* ptr = stbi_load_from_memory(static_cast<const stbi_uc*>(data), size, &w, &h, nullptr,
+                                    static_cast<int>(channels));
   if (!ptr) {
     return false;
   }
 
-  if (data_) {
-    stbi_image_free(data_);
-  }
-  data_ = ptr;
-  width_ = static_cast<uint32_t>(w);
-  height_ = static_cast<uint32_t>(h);
+  Adopt(static_cast<uint32_t>(w), static_cast<uint32_t>(h), format, channels, static_cast<std::size_t>(w) * channels,
+        ptr, FreeStbImage);
   return true;
 }
 
-auto Image::Save(const char* path) -> bool { return !!stbi_write_png(path, width_, height_, 3, data_, width_ * 3); }
+auto Image::PeekShape(const void* data, const std::size_t size, const PixelFormat format)
+    -> std::optional<ImageShape> {
+  if (!IsDecodable(format) || (size > static_cast<std::size_t>(std::numeric_limits<int>::max()))) {
+    return std::nullopt;
+  }
+
+  // Note: Reading the header of some formats allocates the state of the decoder, which the arena provides.
+  const DecodeArena::Scope scope;
+
+  int w{};
+  int h{};
+  if (!stbi_info_from_memory(static_cast<const stbi_uc*>(data), static_cast<int>(size), &w, &h, nullptr)) {
+    return std::nullopt;
+  }
+
+  return ImageShape{static_cast<uint32_t>(w), static_cast<uint32_t>(h), FormatChannels(format), format};
+}
+
+auto Image::Decode(const void* data, const std::size_t size) -> bool {
+  if (!IsDecodable(format_) || Empty() || (size > static_cast<std::size_t>(std::numeric_limits<int>::max()))) {
+    return false;
+  }
+
+  const DecodeArena::Scope scope;
+
+  int w{};
+  int h{};
+  auto* decoded = stbi_load_from_memory(static_cast<const stbi_uc*>(data), static_cast<int>(size), &w, &h, nullptr,
+                                        static_cast<int>(channels_));
+  if (!decoded) {
+    return false;
+  }
+
+  const auto matches = (static_cast<uint32_t>(w) == width_) && (static_cast<uint32_t>(h) == height_);
+  if (matches) {
+    const auto row_size = RowSize();
+    for (uint32_t y = 0; y < height_; y++) {
+      std::memcpy(Row(y), decoded + y * row_size, row_size);
+    }
+  }
+
+  stbi_image_free(decoded);
+  return matches;
+}
+
+auto Image::Save(const char* path) -> bool {
+  if (format_ == PixelFormat::kFloat32) {
+    return false;
+  }
+
+  if (format_ != PixelFormat::kBgr8) {
+    return !!stbi_write_png(path, width_, height_, channels_, Data(), stride_);
+  }
+
+  std::vector<uint8_t> rgb(RowSize() * height_);
+  for (uint32_t y = 0; y < height_; y++) {
+    const auto* src = Row(y);
+    auto* dst = rgb.data() + y * RowSize();
+    for (uint32_t x = 0; x < width_; x++) {
+      dst[x * 3 + 0] = src[x * 3 + 2];
+      dst[x * 3 + 1] = src[x * 3 + 1];
+      dst[x * 3 + 2] = src[x * 3 + 0];
+    }
+  }
+  return !!stbi_write_png(path, width_, height_, 3, rgb.data(), RowSize());
+}
+
+void Image::Adopt(const uint32_t w, const uint32_t h, const PixelFormat format, const uint32_t channels,
+                  const std::size_t stride, uint8_t* data, Deleter deleter) {
+  // Note: The deleter is wrapped so that an empty one can be given for borrowed memory.
+  data_ = std::unique_ptr<uint8_t, Deleter>(data, [deleter = std::move(deleter)](uint8_t* ptr) {
+    if (deleter) {
+      deleter(ptr);
+    }
+  });
+  width_ = w;
+  height_ = h;
+  channels_ = channels;
+  format_ = format;
+  stride_ = stride;
+}
@@ -2,49 +2,214 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <utility>
+
+/**
+ * @brief The layout of the channels of a pixel.
+ * */
+enum class PixelFormat : std::uint8_t {
+  /**
+   * @brief One 8-bit channel.
+   * */
+  kGray8,
+
+  /**
+   * @brief Three 8-bit channels, in the order of red, green and blue.
+   * */
+  kRgb8,
+
+  /**
+   * @brief Three 8-bit channels, in the order of blue, green and red.
+   * */
+  kBgr8,
+
+  /**
+   * @brief Any number of interleaved 32-bit floating point channels.
+   * */
+  kFloat32
+};
+
+/**
+ * @brief The dimensions and pixel layout of an image.
+ * */
+struct ImageShape final {
+  uint32_t width{};
+
+  uint32_t height{};
+
+  uint32_t channels{};
+
+  PixelFormat format{PixelFormat::kRgb8};
+
+  [[nodiscard]] auto operator==(const ImageShape&) const -> bool = default;
+};
 
 class Image final {
  public:
-  Image() noexcept = default;
-
-  Image(uint32_t w, uint32_t h) noexcept;
+  /**
+   * @brief Releases the pixel data of an image.
+   *
+   * @details An empty deleter is used for memory that the image borrows and does not own.
+   * */
+  using Deleter = std::function<void(uint8_t*)>;
+
+  /**
+   * @brief The alignment, in bytes, of the rows of images allocated by this class.
+   * */
+  static constexpr std::size_t alignment{64};
 
-  Image(const uint32_t w, const uint32_t h, uint8_t* data) noexcept : width_(w), height_(h), data_(data) {}
+  Image() noexcept = default;
 
-  Image(Image&& other) noexcept : width_(other.width_), height_(other.height_), data_(other.data_) {
-    other.width_ = 0;
-    other.height_ = 0;
-    other.data_ = nullptr;
-  }
+  /**
+   * @brief Allocates an uninitialized image.
+   *
+   * @details The start of each row is aligned to @ref alignment bytes, so the stride may be larger than the row.
+   *
+   * @param channels The number of channels per pixel. If zero, the number of channels of the format is used.
+   *
+   * @note If the allocation fails, the image is empty.
+   * */
+  Image(uint32_t w, uint32_t h, PixelFormat format = PixelFormat::kRgb8, uint32_t channels = 0) noexcept;
+
+  explicit Image(const ImageShape& shape) noexcept : Image(shape.width, shape.height, shape.format, shape.channels) {}
+
+  /**
+   * @brief Wraps existing pixel data.
+   *
+   * @param stride The number of bytes between the start of each row.
+   * @param deleter Called to release the data once the image is destroyed. May be empty for borrowed data.
+   * */
+  Image(uint32_t w, uint32_t h, PixelFormat format, uint32_t channels, std::size_t stride, uint8_t* data,
+        Deleter deleter) noexcept;
+
+  /**
+   * @note The moved-from image is left empty.
+   * */
+  Image(Image&& other) noexcept
+      : width_(std::exchange(other.width_, 0)),
+        height_(std::exchange(other.height_, 0)),
+        channels_(std::exchange(other.channels_, 0)),
+        format_(other.format_),
+        stride_(std::exchange(other.stride_, 0)),
+        data_(std::move(other.data_)) {}
 
   Image(const Image&) = delete;
 
-  ~Image();
+  ~Image() = default;
 
   auto operator=(const Image&) -> Image& = delete;
 
-  auto operator=(Image&&) -> Image& = delete;
-
-  [[nodiscard]] auto Load(const char* path) -> bool;
+  auto operator=(Image&& other) noexcept -> Image& {
+    if (this != &other) {
+      width_ = std::exchange(other.width_, 0);
+      height_ = std::exchange(other.height_, 0);
+      channels_ = std::exchange(other.channels_, 0);
+      format_ = other.format_;
+      stride_ = std::exchange(other.stride_, 0);
+      data_ = std::move(other.data_);
+    }
+    return *this;
+  }
 
-  [[nodiscard]] auto LoadFromMemory(const void* data, const std::size_t size) -> bool;
+  /**
+   * @brief Gets the default number of channels of a pixel format.
+   * */
+  [[nodiscard]] static auto FormatChannels(PixelFormat format) -> uint32_t;
+
+  /**
+   * @brief Gets the number of bytes per channel of a pixel format.
+   * */
+  [[nodiscard]] static auto FormatChannelSize(PixelFormat format) -> uint32_t;
+
+  /**
+   * @brief The number of pixel buffers that have been allocated by this class since the program started.
+   *
+   * @note Buffers decoded from files or wrapped from existing memory are not counted.
+   * */
+  [[nodiscard]] static auto NumAllocations() -> std::uint64_t;
+
+  /**
+   * @brief Decodes an image file.
+   *
+   * @param format The format to convert the image to. Only @ref PixelFormat::kGray8 and @ref PixelFormat::kRgb8 are
+   * supported.
+   * */
+  [[nodiscard]] auto Load(const char* path, PixelFormat format = PixelFormat::kRgb8) -> bool;
+
+  [[nodiscard]] auto LoadFromMemory(const void* data, const std::size_t size,
+                                    PixelFormat format = PixelFormat::kRgb8) -> bool;
+
+  /**
+   * @brief Reads the shape that an encoded image is decoded to, without decoding it.
+   *
+   * @return The shape, or nothing if the data is not an image that can be decoded to the format.
+   * */
+  [[nodiscard]] static auto PeekShape(const void* data, std::size_t size, PixelFormat format = PixelFormat::kRgb8)
+      -> std::optional<ImageShape>;
+
+  /**
+   * @brief Decodes an image into this one, which must already have the shape given by @ref PeekShape.
+   *
+   * @details Unlike @ref LoadFromMemory, the pixels are copied into the existing buffer, so that images from a pool
+   * can be decoded into. The decoder works in the @ref DecodeArena of the calling thread, so decoding does not
+   * allocate once the arena has grown to fit the largest image.
+   * */
+  [[nodiscard]] auto Decode(const void* data, std::size_t size) -> bool;
 
   [[nodiscard]] auto Save(const char* path) -> bool;
 
-  [[nodiscard]] auto Data() -> uint8_t* { return data_; }
+  [[nodiscard]] auto Data() -> uint8_t* { return data_.get(); }
 
-  [[nodiscard]] auto Data() const -> const uint8_t* { return data_; }
+  [[nodiscard]] auto Data() const -> const uint8_t* { return data_.get(); }
+
+  [[nodiscard]] auto Row(const uint32_t y) -> uint8_t* { return data_.get() + y * stride_; }
+
+  [[nodiscard]] auto Row(const uint32_t y) const -> const uint8_t* { return data_.get() + y * stride_; }
 
   [[nodiscard]] auto Width() const -> uint32_t { return width_; }
 
   [[nodiscard]] auto Height() const -> uint32_t { return height_; }
 
+  [[nodiscard]] auto Channels() const -> uint32_t { return channels_; }
+
+  [[nodiscard]] auto Format() const -> PixelFormat { return format_; }
+
+  [[nodiscard]] auto Shape() const -> ImageShape { return ImageShape{width_, height_, channels_, format_}; }
+
+  /**
+   * @brief The number of bytes between the start of each row.
+   * */
+  [[nodiscard]] auto Stride() const -> std::size_t { return stride_; }
+
+  /**
+   * @brief The number of bytes in a pixel.
+   * */
+  [[nodiscard]] auto PixelSize() const -> std::size_t { return channels_ * FormatChannelSize(format_); }
+
+  /**
+   * @brief The number of bytes of pixel data in a row, which excludes the padding at the end of the row.
+   * */
+  [[nodiscard]] auto RowSize() const -> std::size_t { return width_ * PixelSize(); }
+
   [[nodiscard]] auto Empty() const -> bool { return (width_ == 0) || (height_ == 0); }
 
+ protected:
+  void Adopt(uint32_t w, uint32_t h, PixelFormat format, uint32_t channels, std::size_t stride, uint8_t* data,
+             Deleter deleter);
+
  private:
   uint32_t width_{};
 
   uint32_t height_{};
 
-  uint8_t* data_{};
+  uint32_t channels_{};
+
+  PixelFormat format_{PixelFormat::kRgb8};
+
+  std::size_t stride_{};
+
+  std::unique_ptr<uint8_t, Deleter> data_;
 };
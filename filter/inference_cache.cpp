@@ -0,0 +1,303 @@
+#include "inference_cache.h"
+
+#include <spdlog/spdlog.h>
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+namespace {
+
+[[nodiscard]] auto Mix(std::uint64_t x) -> std::uint64_t {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+[[nodiscard]] auto ToHex(const std::uint64_t value) -> std::string {
+  std::ostringstream stream;
+  stream << std::hex << std::setw(16) << std::setfill('0') << value;
+  return stream.str();
+}
+
+/**
+ * @brief The header of a prediction stored on disk, followed by the prediction data.
+ * */
+struct FileHeader final {
+  std::int32_t rows{};
+  std::int32_t cols{};
+  std::int32_t type{};
+  std::int32_t reserved{};
+};
+
+}  // namespace
+
+InferenceCache::InferenceCache(const pipeline::InferenceCacheConfig& config, const std::uint64_t model_hash)
+    : config_(config), model_hash_(model_hash) {
+  if (!config_.path().empty()) {
+    CreateModelDirectory();
+  }
+
+  SPDLOG_INFO("Inference cache holds {} predictions in memory and uses '{}' on disk.", config_.memory_capacity(),
+              config_.path());
+}
+
+auto InferenceCache::Hash(const void* data, const std::size_t size, const std::uint64_t seed) -> std::uint64_t {
+  constexpr std::uint64_t golden_ratio{0x9e3779b97f4a7c15ULL};
+
+  const auto* bytes = static_cast<const std::uint8_t*>(data);
+
+  auto h = Mix(seed ^ (size * golden_ratio));
+
+  std::size_t i{};
+
+  for (; (i + 8) <= size; i += 8) {
+    std::uint64_t word{};
+    std::memcpy(&word, bytes + i, 8);
+    h = Mix(h ^ word) + golden_ratio;
+  }
+
+  if (i < size) {
+    std::uint64_t word{};
+    std::memcpy(&word, bytes + i, size - i);
+    h = Mix(h ^ word) + golden_ratio;
+  }
+
+  return Mix(h);
+}
+
+auto InferenceCache::Hash(const Image& image) -> std::uint64_t {
+  const std::array<std::uint32_t, 4> shape{image.Width(), image.Height(), image.Channels(),
+                                           static_cast<std::uint32_t>(image.Format())};
+
+  auto h = Hash(shape.data(), sizeof(shape));
+
+  for (std::uint32_t y = 0; y < image.Height(); y++) {
+    h = Hash(image.Row(y), image.RowSize(), h);
+  }
+
+  return h;
+}
+
+auto InferenceCache::Hash(const Tensor& tensor) -> std::uint64_t {
+  const std::array<std::uint32_t, 4> shape{tensor.Width(), tensor.Height(), tensor.Channels(),
+                                           static_cast<std::uint32_t>(PixelFormat::kFloat32)};
+
+  return Hash(tensor.Data(), tensor.Size() * sizeof(float), Hash(shape.data(), sizeof(shape)));
+}
+
+void InferenceCache::SetModel(const std::uint64_t model_hash) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (model_hash == model_hash_) {
+    return;
+  }
+
+  SPDLOG_INFO("Model changed, invalidating inference cache.");
+
+  model_hash_ = model_hash;
+  entries_.clear();
+  index_.clear();
+
+  if (!config_.path().empty()) {
+    RemoveCreatedDirectory();
+    CreateModelDirectory();
+  }
+}
+
+auto InferenceCache::ModelHash() const -> std::uint64_t {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return model_hash_;
+}
+
+auto InferenceCache::Find(const InferenceKey& key) -> cv::Mat {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto it = index_.find(key); it != index_.end()) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      memory_hits_++;
+      return it->second->prediction;
+    }
+  }
+
+  if (!config_.path().empty()) {
+    auto prediction = Load(key);
+    if (!prediction.empty()) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      disk_hits_++;
+      InsertInMemory(key, prediction);
+      return prediction;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  misses_++;
+
+  return cv::Mat();
+}
+
+void InferenceCache::Insert(const InferenceKey& key, const cv::Mat& prediction) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    InsertInMemory(key, prediction);
+  }
+
+  if (!config_.path().empty()) {
+    Store(key, prediction);
+  }
+}
+
+void InferenceCache::LogStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const auto lookups = memory_hits_ + disk_hits_ + misses_;
+  if (lookups == 0) {
+    return;
+  }
+
+  const auto percent = [lookups](const std::uint64_t count) { return 100.0 * count / lookups; };
+
+  SPDLOG_INFO("Inference cache: {} lookups, {:.1f}% memory hits, {:.1f}% disk hits, {:.1f}% misses.", lookups,
+              percent(memory_hits_), percent(disk_hits_), percent(misses_));
+}
+
+auto InferenceCache::KeyHash::operator()(const InferenceKey& key) const -> std::size_t {
+  return static_cast<std::size_t>(Hash(key.infill.data(), sizeof(key.infill), key.model_hash ^ key.content_hash));
+}
+
+auto InferenceCache::ModelDirectory() const -> std::filesystem::path {
+  return std::filesystem::path(config_.path()) / ToHex(model_hash_);
+}
+
+auto InferenceCache::EntryPath(const InferenceKey& key) const -> std::filesystem::path {
+  std::ostringstream name;
+  name << ToHex(key.content_hash) << '_' << key.infill[0] << '_' << key.infill[1] << '_' << key.infill[2] << '_'
+       << key.infill[3] << ".bin";
+  return std::filesystem::path(config_.path()) / ToHex(key.model_hash) / name.str();
+}
+
+void InferenceCache::CreateModelDirectory() {
+  const auto directory = ModelDirectory();
+  std::error_code err;
+  const auto created = std::filesystem::create_directories(directory, err);
+  if (err) {
+    SPDLOG_ERROR("Failed to create inference cache directory '{}': {}", directory.string(), err.message());
+  }
+  if (created) {
+    created_directory_ = directory;
+  }
+}
+
+void InferenceCache::RemoveCreatedDirectory() {
+  if (!created_directory_) {
+    return;
+  }
+  SPDLOG_INFO("Removing inference cache directory '{}' of the previous model.", created_directory_->string());
+  std::error_code err;
+  std::filesystem::remove_all(*created_directory_, err);
+  if (err) {
+    SPDLOG_WARN("Failed to remove '{}': {}", created_directory_->string(), err.message());
+  }
+  created_directory_.reset();
+}
+
+void InferenceCache::InsertInMemory(const InferenceKey& key, const cv::Mat& prediction) {
+  if (config_.memory_capacity() == 0) {
+    return;
+  }
+
+  if (auto it = index_.find(key); it != index_.end()) {
+    it->second->prediction = prediction;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return;
+  }
+
+  while (entries_.size() >= config_.memory_capacity()) {
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+
+  entries_.push_front(Entry{key, prediction});
+  index_.emplace(key, entries_.begin());
+}
+
+auto InferenceCache::Load(const InferenceKey& key) const -> cv::Mat {
+  const auto path = EntryPath(key);
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file.good()) {
+    return cv::Mat();
+  }
+
+  FileHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+    return cv::Mat();
+  }
+
+  // Note: Only the types of predictions are accepted, so that a foreign or damaged file cannot ask for an arbitrary
+  //       allocation.
+  if ((header.rows <= 0) || (header.cols <= 0) || ((header.type != CV_32FC1) && (header.type != CV_32FC3))) {
+    SPDLOG_WARN("Ignoring '{}', which is not a cached prediction.", path.string());
+    return cv::Mat();
+  }
+
+  const auto channels = (header.type == CV_32FC3) ? 3U : 1U;
+  const auto size = static_cast<std::uintmax_t>(header.rows) * static_cast<std::uintmax_t>(header.cols) * channels *
+                    sizeof(float);
+
+  std::error_code err;
+  const auto file_size = std::filesystem::file_size(path, err);
+  if (err || (file_size != (sizeof(header) + size))) {
+    SPDLOG_WARN("Ignoring '{}', whose size does not match its header.", path.string());
+    return cv::Mat();
+  }
+
+  cv::Mat prediction(header.rows, header.cols, header.type);
+
+  if (!file.read(reinterpret_cast<char*>(prediction.data), static_cast<std::streamsize>(size))) {
+    return cv::Mat();
+  }
+
+  return prediction;
+}
+
+void InferenceCache::Store(const InferenceKey& key, const cv::Mat& prediction) const {
+  const auto path = EntryPath(key);
+
+  // Note: The prediction is written to a temporary file first, so that a partially written file is never loaded.
+  auto tmp_path = path;
+  tmp_path += ".tmp";
+
+  {
+    std::ofstream file(tmp_path, std::ios::binary);
+    if (!file.good()) {
+      SPDLOG_WARN("Failed to open '{}' for writing.", tmp_path.string());
+      return;
+    }
+
+    const auto contiguous = prediction.isContinuous() ? prediction : prediction.clone();
+
+    const FileHeader header{contiguous.rows, contiguous.cols, contiguous.type(), 0};
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(contiguous.data),
+               static_cast<std::streamsize>(contiguous.total() * contiguous.elemSize()));
+    if (!file.good()) {
+      SPDLOG_WARN("Failed to write '{}'.", tmp_path.string());
+      return;
+    }
+  }
+
+  std::error_code err;
+  std::filesystem::rename(tmp_path, path, err);
+  if (err) {
+    SPDLOG_WARN("Failed to move '{}' into place: {}", tmp_path.string(), err.message());
+  }
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <pipeline/inference_cache_config.pb.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <optional>
+#include <unordered_map>
+
+#include "image.h"
+#include "tensor.h"
+
+/**
+ * @brief Identifies the prediction of a network for a given input.
+ * */
+struct InferenceKey final {
+  /**
+   * @brief The hash of the model file that made the prediction.
+   * */
+  std::uint64_t model_hash{};
+
+  /**
+   * @brief The hash of the network input.
+   * */
+  std::uint64_t content_hash{};
+
+  /**
+   * @brief The infill rectangle, as x, y, width and height.
+   * */
+  std::array<std::uint32_t, 4> infill{};
+
+  [[nodiscard]] auto operator==(const InferenceKey&) const -> bool = default;
+};
+
+/**
+ * @brief Caches network predictions in memory and on disk, keyed by the content of the network input.
+ *
+ * @details The in-memory tier evicts the least recently used prediction once it is full. The on-disk tier stores
+ * each prediction in a directory named after the model hash, so predictions of other models are never found. When
+ * the model changes, the in-memory tier is cleared and the directories of other models are removed.
+ *
+ * @note The cache may be used from several threads at once.
+ * */
+class InferenceCache final {
+ public:
+  InferenceCache(const pipeline::InferenceCacheConfig& config, std::uint64_t model_hash);
+
+  /**
+   * @brief Computes a 64-bit hash of a block of memory.
+   * */
+  [[nodiscard]] static auto Hash(const void* data, std::size_t size, std::uint64_t seed = 0) -> std::uint64_t;
+
+  /**
+   * @brief Computes a 64-bit hash of the shape, format and pixels of an image.
+   *
+   * @note The padding at the end of each row is not included.
+   * */
+  [[nodiscard]] static auto Hash(const Image& image) -> std::uint64_t;
+
+  /**
+   * @brief Computes a 64-bit hash of the shape and values of a tensor.
+   * */
+  [[nodiscard]] static auto Hash(const Tensor& tensor) -> std::uint64_t;
+
+  /**
+   * @brief Changes the model that predictions are stored for, dropping the predictions of the previous model.
+   * */
+  void SetModel(std::uint64_t model_hash);
+
+  [[nodiscard]] auto ModelHash() const -> std::uint64_t;
+
+  /**
+   * @brief Looks up a prediction, first in memory and then on disk.
+   *
+   * @return The prediction, or an empty matrix if it is not in the cache.
+   * */
+  [[nodiscard]] auto Find(const InferenceKey& key) -> cv::Mat;
+
+  /**
+   * @brief Adds a prediction to the cache.
+   *
+   * @note The prediction is stored by reference in memory, so it must not be modified afterwards.
+   * */
+  void Insert(const InferenceKey& key, const cv::Mat& prediction);
+
+  /**
+   * @brief Logs the hit rate of each tier.
+   * */
+  void LogStats() const;
+
+ protected:
+  struct KeyHash final {
+    [[nodiscard]] auto operator()(const InferenceKey& key) const -> std::size_t;
+  };
+
+  struct Entry final {
+    InferenceKey key;
+
+    cv::Mat prediction;
+  };
+
+  [[nodiscard]] auto ModelDirectory() const -> std::filesystem::path;
+
+  [[nodiscard]] auto EntryPath(const InferenceKey& key) const -> std::filesystem::path;
+
+  void CreateModelDirectory();
+
+  /**
+   * @brief Removes the directory of the current model, if this cache created it.
+   *
+   * @note Directories of other models are left alone, since other pipelines may share the same cache path.
+   * */
+  void RemoveCreatedDirectory();
+
+  void InsertInMemory(const InferenceKey& key, const cv::Mat& prediction);
+
+  [[nodiscard]] auto Load(const InferenceKey& key) const -> cv::Mat;
+
+  void Store(const InferenceKey& key, const cv::Mat& prediction) const;
+
+ private:
+  pipeline::InferenceCacheConfig config_;
+
+  mutable std::mutex mutex_;
+
+  std::uint64_t model_hash_{};
+
+  /**
+   * @brief The model directory that this cache created, if it did not exist before.
+   * */
+  std::optional<std::filesystem::path> created_directory_;
+
+  std::list<Entry> entries_;
+
+  std::unordered_map<InferenceKey, std::list<Entry>::iterator, KeyHash> index_;
+
+  std::uint64_t memory_hits_{};
+
+  std::uint64_t disk_hits_{};
+
+  std::uint64_t misses_{};
+};
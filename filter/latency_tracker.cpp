@@ -0,0 +1,91 @@
+#include "latency_tracker.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+
+namespace {
+
+[[nodiscard]] auto ToMilliseconds(const StageTimes::Clock::duration duration) -> double {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+/**
+ * @note The samples must be sorted.
+ * */
+[[nodiscard]] auto Percentile(const std::vector<double>& samples, const double p) -> double {
+  const auto index = static_cast<std::size_t>(std::ceil(p * static_cast<double>(samples.size()))) - 1;
+  return samples[std::min(index, samples.size() - 1)];
+}
+
+}  // namespace
+
+LatencyTracker::LatencyTracker(std::string name, const std::chrono::milliseconds interval)
+    : name_(std::move(name)),
+      interval_((interval.count() == 0) ? std::chrono::milliseconds(10000) : interval),
+      last_report_(StageTimes::Clock::now()) {
+  // Note: Enough room for a report interval of frames at a high frame rate, so that recording does not allocate.
+  samples_.reserve(4096);
+}
+
+void LatencyTracker::Record(const StageTimes& times) {
+  const auto origin = times.Origin();
+  if (!origin || !times.Has(Stage::kSink)) {
+    return;
+  }
+
+  samples_.emplace_back(ToMilliseconds(times.Get(Stage::kSink) - *origin));
+
+  auto previous = *origin;
+
+  for (std::size_t i = 0; i < num_stages; i++) {
+    const auto stage = static_cast<Stage>(i);
+    // Note: The stage that the latency is measured from is not counted, since no time is spent reaching it.
+    if (!times.Has(stage) || (times.Get(stage) <= *origin) || (times.Get(stage) < previous)) {
+      continue;
+    }
+    stage_total_[i] += ToMilliseconds(times.Get(stage) - previous);
+    stage_count_[i]++;
+    previous = times.Get(stage);
+  }
+
+  if ((times.Get(Stage::kSink) - last_report_) >= interval_) {
+    Report();
+  }
+}
+
+void LatencyTracker::Report() {
+  last_report_ = StageTimes::Clock::now();
+
+  if (samples_.empty()) {
+    return;
+  }
+
+  std::sort(samples_.begin(), samples_.end());
+
+  SPDLOG_INFO("Latency at {} over {} outputs: p50 {:.1f} ms, p90 {:.1f} ms, p99 {:.1f} ms, max {:.1f} ms.", name_,
+              samples_.size(), Percentile(samples_, 0.5), Percentile(samples_, 0.9), Percentile(samples_, 0.99),
+              samples_.back());
+
+  std::string breakdown;
+
+  for (std::size_t i = 0; i < num_stages; i++) {
+    if (stage_count_[i] == 0) {
+      continue;
+    }
+    if (!breakdown.empty()) {
+      breakdown += ", ";
+    }
+    breakdown += fmt::format("{} {:.1f} ms", StageTimes::Name(static_cast<Stage>(i)),
+                             stage_total_[i] / static_cast<double>(stage_count_[i]));
+  }
+
+  SPDLOG_INFO("Mean time per stage at {}: {}.", name_, breakdown);
+
+  samples_.clear();
+  stage_total_.fill(0.0);
+  stage_count_.fill(0);
+}
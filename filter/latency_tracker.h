@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "node.h"
+
+/**
+ * @brief Collects the latency of the outputs that reach a sink and periodically logs its distribution.
+ *
+ * @details The end-to-end latency of an output is the time from the capture of its frame, or from when the source
+ * received it if the capture time is unknown, to the sink. It is broken down by stage, where the time of a stage is
+ * the time since the previous stage that the output passed.
+ * */
+class LatencyTracker final {
+ public:
+  /**
+   * @param name The name of the sink, used in the report.
+   *
+   * @param interval How often to log the report. If zero, it is logged every ten seconds.
+   * */
+  LatencyTracker(std::string name, std::chrono::milliseconds interval);
+
+  /**
+   * @brief Adds the latency of an output that has reached the sink, and logs the report if it is due.
+   * */
+  void Record(const StageTimes& times);
+
+  /**
+   * @brief Logs the report of the outputs that were recorded since the last report and starts a new one.
+   * */
+  void Report();
+
+ private:
+  std::string name_;
+
+  std::chrono::milliseconds interval_;
+
+  StageTimes::Clock::time_point last_report_;
+
+  /**
+   * @brief The end-to-end latency of each output since the last report, in milliseconds.
+   * */
+  std::vector<double> samples_;
+
+  std::array<double, num_stages> stage_total_{};
+
+  std::array<std::uint64_t, num_stages> stage_count_{};
+};
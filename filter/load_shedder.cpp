@@ -0,0 +1,284 @@
+#include "load_shedder.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief The weight of the latest frame in the moving average of the time that the pipeline takes per frame.
+ * */
+constexpr double latency_smoothing{0.2};
+
+/**
+ * @brief The number of frames to wait after changing the degradation level before changing it again, so that the
+ * moving average can catch up with the effect of the change.
+ * */
+constexpr std::uint32_t degradation_cooldown{8};
+
+struct QueuedFrame final {
+  NodeOutput output;
+
+  Clock::time_point received;
+};
+
+class LoadShedderImpl final : public LoadShedder {
+ public:
+  LoadShedderImpl(std::unique_ptr<Node> child, const pipeline::LoadSheddingConfig& config,
+                  std::shared_ptr<LoadState> state)
+      : child_(std::move(child)),
+        config_(config),
+        state_(std::move(state)),
+        queue_size_(std::max(config.queue_size(), 1u)),
+        max_degradation_((config.max_degradation() == 0) ? 3 : config.max_degradation()),
+        stats_interval_((config.stats_interval_ms() == 0) ? 10000 : config.stats_interval_ms()) {}
+
+  ~LoadShedderImpl() override {
+    if (!thread_.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    space_condition_.notify_all();
+    // Note: Closing the source ends a step that is waiting for a frame.
+    child_->Close();
+    thread_.join();
+  }
+
+  [[nodiscard]] auto Step() -> NodeOutput override {
+    if (!thread_.joinable()) {
+      last_stats_ = Clock::now();
+      thread_ = std::thread([this]() { Produce(); });
+    } else if (last_return_) {
+      UpdateLatency(Clock::now() - *last_return_);
+    }
+
+    while (true) {
+      std::optional<QueuedFrame> frame;
+      bool was_full{};
+
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        frame_condition_.wait(lock, [this]() { return !queue_.empty() || end_of_stream_; });
+        if (queue_.empty()) {
+          state_->LogStats();
+          return NodeOutput();
+        }
+        was_full = queue_.size() >= queue_size_;
+        frame = std::move(queue_.front());
+        queue_.pop_front();
+      }
+
+      space_condition_.notify_one();
+
+      const auto now = Clock::now();
+
+      MaybeLogStats(now);
+
+      if (IsStale(*frame, now)) {
+        state_->stale_frames++;
+        continue;
+      }
+
+      if (ShouldSkip(was_full)) {
+        state_->skipped_frames++;
+        continue;
+      }
+
+      state_->passed_frames++;
+
+      last_return_ = Clock::now();
+
+      frame->output.times.Set(Stage::kDequeue, *last_return_);
+
+      return std::move(frame->output);
+    }
+  }
+
+  [[nodiscard]] auto Prepare() -> bool override { return child_->Prepare(); }
+
+  void Close() override { child_->Close(); }
+
+  [[nodiscard]] auto Plan(const std::array<std::uint32_t, 2>& frame_size) -> OutputPlan override {
+    return child_->Plan(frame_size);
+  }
+
+ protected:
+  /**
+   * @brief Steps the source until it reaches the end of its stream, queueing its outputs.
+   * */
+  void Produce() {
+    while (true) {
+      auto output = child_->Step();
+
+      const auto received = Clock::now();
+
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        if (output.EndOfStream()) {
+          end_of_stream_ = true;
+          frame_condition_.notify_all();
+          return;
+        }
+
+        if (config_.queue_policy() == pipeline::QueuePolicy::DROP_OLDEST) {
+          while (queue_.size() >= queue_size_) {
+            queue_.pop_front();
+            state_->evicted_frames++;
+          }
+        } else {
+          space_condition_.wait(lock, [this]() { return (queue_.size() < queue_size_) || stop_; });
+        }
+
+        if (stop_) {
+          return;
+        }
+
+        queue_.emplace_back(QueuedFrame{std::move(output), received});
+      }
+
+      frame_condition_.notify_one();
+    }
+  }
+
+  [[nodiscard]] auto IsStale(const QueuedFrame& frame, const Clock::time_point now) const -> bool {
+    if (config_.max_frame_age_ms() == 0) {
+      return false;
+    }
+    const auto produced = frame.output.times.Origin().value_or(frame.received);
+    return (now - produced) > std::chrono::milliseconds(config_.max_frame_age_ms());
+  }
+
+  [[nodiscard]] auto OverBudget() const -> bool {
+    if (!latency_ || (config_.latency_budget_ms() == 0)) {
+      return false;
+    }
+    return *latency_ > static_cast<double>(config_.latency_budget_ms());
+  }
+
+  [[nodiscard]] auto ShouldSkip(const bool queue_full) -> bool {
+    if ((config_.skip_every() == 0) || !(queue_full || OverBudget())) {
+      skip_counter_ = 0;
+      return false;
+    }
+    skip_counter_++;
+    if (skip_counter_ < config_.skip_every()) {
+      return false;
+    }
+    skip_counter_ = 0;
+    return true;
+  }
+
+  /**
+   * @brief Updates the moving average of the time that the pipeline takes per frame and, in adaptive mode, the
+   * degradation level.
+   *
+   * @param elapsed The time between passing on the last frame and the pipeline asking for the next one.
+   * */
+  void UpdateLatency(const Clock::duration elapsed) {
+    const auto ms = std::chrono::duration<double, std::milli>(elapsed).count();
+
+    latency_ = latency_ ? ((1.0 - latency_smoothing) * *latency_ + latency_smoothing * ms) : ms;
+
+    if (!config_.adaptive_stride() || (config_.latency_budget_ms() == 0)) {
+      return;
+    }
+
+    if (cooldown_ > 0) {
+      cooldown_--;
+      return;
+    }
+
+    const auto budget = static_cast<double>(config_.latency_budget_ms());
+    const auto level = state_->Degradation();
+
+    // Note: The level is only lowered once the pipeline is well within its budget, so that it does not flip between
+    //       two levels that are both close to the budget.
+    if ((*latency_ > budget) && (level < max_degradation_)) {
+      state_->SetDegradation(level + 1);
+      SPDLOG_WARN("Pipeline takes {:.1f} ms per frame, over its budget of {} ms, raising degradation to level {}.",
+                  *latency_, config_.latency_budget_ms(), level + 1);
+      cooldown_ = degradation_cooldown;
+    } else if ((*latency_ < (budget * 0.5)) && (level > 0)) {
+      state_->SetDegradation(level - 1);
+      SPDLOG_INFO("Pipeline takes {:.1f} ms per frame, lowering degradation to level {}.", *latency_, level - 1);
+      cooldown_ = degradation_cooldown;
+    }
+  }
+
+  void MaybeLogStats(const Clock::time_point now) {
+    if ((now - last_stats_) < stats_interval_) {
+      return;
+    }
+    last_stats_ = now;
+    state_->LogStats();
+  }
+
+ private:
+  std::unique_ptr<Node> child_;
+
+  pipeline::LoadSheddingConfig config_;
+
+  std::shared_ptr<LoadState> state_;
+
+  std::size_t queue_size_{1};
+
+  std::uint32_t max_degradation_{};
+
+  std::chrono::milliseconds stats_interval_;
+
+  std::thread thread_;
+
+  std::mutex mutex_;
+
+  std::condition_variable frame_condition_;
+
+  std::condition_variable space_condition_;
+
+  /**
+   * @brief The frames that have been read from the source but not yet taken by the pipeline.
+   * */
+  std::deque<QueuedFrame> queue_;
+
+  bool end_of_stream_{};
+
+  bool stop_{};
+
+  /**
+   * @brief The moving average of the time, in milliseconds, that the pipeline takes per frame.
+   * */
+  std::optional<double> latency_;
+
+  std::optional<Clock::time_point> last_return_;
+
+  Clock::time_point last_stats_;
+
+  std::uint32_t skip_counter_{};
+
+  std::uint32_t cooldown_{};
+};
+
+}  // namespace
+
+void LoadState::LogStats() const {
+  SPDLOG_INFO("Load shedding: {} frames passed, {} stale, {} evicted, {} skipped, degradation level {}.",
+              passed_frames.load(), stale_frames.load(), evicted_frames.load(), skipped_frames.load(), Degradation());
+}
+
+auto LoadShedder::Create(std::unique_ptr<Node> child, const pipeline::LoadSheddingConfig& config,
+                         std::shared_ptr<LoadState> state) -> std::unique_ptr<LoadShedder> {
+  return std::make_unique<LoadShedderImpl>(std::move(child), config, std::move(state));
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <pipeline/load_shedding_config.pb.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "node.h"
+
+/**
+ * @brief The load of a pipeline, shared between the load shedders that drop frames and the filters that process
+ * frames more coarsely to keep up.
+ *
+ * @note This may be used from several threads at once.
+ * */
+class LoadState final {
+ public:
+  /**
+   * @brief How far the pipeline has degraded its output to keep up, where zero is not at all.
+   * */
+  [[nodiscard]] auto Degradation() const -> std::uint32_t { return degradation_.load(std::memory_order_relaxed); }
+
+  void SetDegradation(const std::uint32_t level) { degradation_.store(level, std::memory_order_relaxed); }
+
+  /**
+   * @brief The factor by which tile filters widen their stride at the current degradation level.
+   * */
+  [[nodiscard]] auto StrideScale() const -> std::uint32_t { return Degradation() + 1; }
+
+  /**
+   * @brief Frames that were dropped because they were too old when the pipeline took them.
+   * */
+  std::atomic<std::uint64_t> stale_frames{0};
+
+  /**
+   * @brief Frames that were dropped to make room in a full queue.
+   * */
+  std::atomic<std::uint64_t> evicted_frames{0};
+
+  /**
+   * @brief Frames that were skipped while the pipeline was under pressure.
+   * */
+  std::atomic<std::uint64_t> skipped_frames{0};
+
+  /**
+   * @brief Frames that were passed on to the pipeline.
+   * */
+  std::atomic<std::uint64_t> passed_frames{0};
+
+  /**
+   * @brief Logs the drop counters and the degradation level.
+   * */
+  void LogStats() const;
+
+ private:
+  std::atomic<std::uint32_t> degradation_{0};
+};
+
+/**
+ * @brief Reads a source ahead of the rest of the pipeline and drops frames when the pipeline falls behind.
+ *
+ * @details The source is stepped on a thread of its own, which fills a short queue. Frames are dropped when the queue
+ * is full, when they are too old by the time the pipeline takes them, or periodically while the pipeline is under
+ * pressure. In adaptive mode, the time that the pipeline takes per frame also drives the degradation level of the
+ * load state.
+ * */
+class LoadShedder : public Node {
+ public:
+  static auto Create(std::unique_ptr<Node> child, const pipeline::LoadSheddingConfig& config,
+                     std::shared_ptr<LoadState> state) -> std::unique_ptr<LoadShedder>;
+
+  ~LoadShedder() override = default;
+};
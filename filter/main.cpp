@@ -1,19 +1,50 @@
+#include <pipeline/config.pb.h>
 #include <spdlog/spdlog.h>
 #include <zmq.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <memory>
+#include <new>
+#include <optional>
 
 #include "exception.h"
 #include "node.h"
+#include "pipeline_watcher.h"
 
 namespace {
 
+/**
+ * @brief The number of allocations made through operator new since the program started.
+ * */
+std::atomic<std::uint64_t> num_heap_allocations{0};
+
+[[nodiscard]] auto CountedAllocate(const std::size_t size, const std::size_t alignment) -> void* {
+  num_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+  // Note: The size of an aligned allocation must be a multiple of its alignment.
+  const auto aligned_size = ((std::max<std::size_t>(size, 1) + alignment - 1) / alignment) * alignment;
+  auto* ptr = (alignment <= alignof(std::max_align_t)) ? std::malloc(aligned_size)
+                                                        : std::aligned_alloc(alignment, aligned_size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
 class Program final {
  public:
   [[nodiscard]] auto Setup() -> bool {
     zmq_context_ = zmq_ctx_new();
     try {
-      root_ = Node::CreatePipeline(zmq_context_, "pipeline.json");
+      const auto config = Node::LoadConfig(config_path);
+      root_ = Node::CreatePipeline(zmq_context_, config);
+      Node::PreparePipeline(*root_, config);
+      if (config.hot_reload()) {
+        watcher_ = std::make_unique<PipelineWatcher>(zmq_context_, config_path, config);
+      }
     } catch (const Exception& e) {
       SPDLOG_ERROR("Failed to load pipeline: '{}'", e.what());
       return false;
@@ -22,28 +53,110 @@ class Program final {
   }
 
   void Teardown() {
+    watcher_.reset();
     root_.reset();
     zmq_ctx_destroy(zmq_context_);
   }
 
   void Run() {
     while (true) {
+      if (watcher_) {
+        if (auto next = watcher_->TakePipeline()) {
+          Switch(std::move(next));
+        }
+      }
       auto output = root_->Step();
       if (output.EndOfStream()) {
         SPDLOG_INFO("Reached end of stream.");
         break;
       }
+      if (!warm_allocations_) {
+        warm_allocations_ = NumAllocations();
+      }
+    }
+    LogAllocations();
+  }
+
+ protected:
+  /**
+   * @brief Replaces the running pipeline with a new one.
+   *
+   * @details The running pipeline is closed and stepped until the outputs it already has in progress have reached its
+   * sinks, so that no frame that was taken from a source is lost.
+   * */
+  void Switch(std::unique_ptr<Node> next) {
+    SPDLOG_INFO("Switching to new pipeline.");
+    root_->Close();
+    std::size_t num_drained{};
+    while (!root_->Step().EndOfStream()) {
+      num_drained++;
+    }
+    SPDLOG_INFO("Drained {} outputs from the previous pipeline.", num_drained);
+    LogAllocations();
+    root_ = std::move(next);
+    warm_allocations_.reset();
+  }
+
+  struct Allocations final {
+    std::uint64_t heap{};
+
+    std::uint64_t buffers{};
+  };
+
+  [[nodiscard]] static auto NumAllocations() -> Allocations {
+    return Allocations{num_heap_allocations.load(std::memory_order_relaxed),
+                       Image::NumAllocations() + Tensor::NumAllocations()};
+  }
+
+  /**
+   * @brief Logs the number of allocations that were made after the first output of the pipeline.
+   *
+   * @details A planned pipeline reuses its buffers and jobs, so both counts should be zero. The heap count covers
+   * everything that is allocated through operator new, including inside libraries written in C++. Memory that
+   * libraries allocate with malloc directly, such as the message buffers of ZeroMQ and the matrices of OpenCV, is
+   * not included.
+   * */
+  void LogAllocations() const {
+    if (warm_allocations_) {
+      const auto now = NumAllocations();
+      SPDLOG_INFO("Made {} heap allocations and allocated {} image and tensor buffers after warm-up.",
+                  now.heap - warm_allocations_->heap, now.buffers - warm_allocations_->buffers);
     }
   }
 
  private:
+  static constexpr const char* config_path{"pipeline.json"};
+
   void* zmq_context_{};
 
   std::unique_ptr<Node> root_;
+
+  std::unique_ptr<PipelineWatcher> watcher_;
+
+  /**
+   * @brief The allocations that had been made once the pipeline produced its first output.
+   * */
+  std::optional<Allocations> warm_allocations_;
 };
 
 }  // namespace
 
+// Note: The global allocation functions are replaced to count the allocations. The array and non-throwing forms call
+//       these by default.
+auto operator new(const std::size_t size) -> void* { return CountedAllocate(size, alignof(std::max_align_t)); }
+
+auto operator new(const std::size_t size, const std::align_val_t alignment) -> void* {
+  return CountedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+
 auto main() -> int {
   Program program;
   if (!program.Setup()) {
@@ -4,17 +4,26 @@
 #include <pipeline/config.pb.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <fstream>
+#include <opencv2/core.hpp>
 #include <opencv2/core/utils/logger.hpp>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include "detection_filter.h"
 #include "directory_sink.h"
 #include "directory_source.h"
 #include "exception.h"
 #include "frame_builder.h"
+#include "load_shedder.h"
 #include "normalize_filter.h"
+#include "replay_source.h"
+#include "synthetic_source.h"
+#include "tee.h"
 #include "tile_filter.h"
 #include "zmq_sink.h"
 #include "zmq_source.h"
@@ -24,11 +33,238 @@ namespace {
 class NullNode final : public Node {
  public:
   auto Step() -> NodeOutput override { return NodeOutput(); }
+
+  auto Plan(const std::array<std::uint32_t, 2>&) -> OutputPlan override { return OutputPlan{ImageShape{}, 0}; }
+};
+
+/**
+ * @brief Steps several terminal nodes together, until all of them reach the end of their streams.
+ * */
+class TerminalGroup final : public Node {
+ public:
+  explicit TerminalGroup(std::vector<std::unique_ptr<Node>> terminals)
+      : terminals_(std::move(terminals)), finished_(terminals_.size(), false) {}
+
+  /**
+   * @return The output of the first terminal that has not yet finished.
+   * */
+  auto Step() -> NodeOutput override {
+    NodeOutput result;
+    for (std::size_t i = 0; i < terminals_.size(); i++) {
+      if (finished_[i]) {
+        continue;
+      }
+      auto output = terminals_[i]->Step();
+      if (output.EndOfStream()) {
+        finished_[i] = true;
+      } else if (result.EndOfStream()) {
+        result = std::move(output);
+      }
+    }
+    return result;
+  }
+
+  [[nodiscard]] auto Prepare() -> bool override {
+    for (auto& terminal : terminals_) {
+      if (!terminal->Prepare()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void Close() override {
+    for (auto& terminal : terminals_) {
+      terminal->Close();
+    }
+  }
+
+  /**
+   * @return The plan of the first terminal.
+   * */
+  auto Plan(const std::array<std::uint32_t, 2>& frame_size) -> OutputPlan override {
+    std::optional<OutputPlan> first;
+    for (auto& terminal : terminals_) {
+      auto plan = terminal->Plan(frame_size);
+      if (!first) {
+        first = plan;
+      }
+    }
+    return first.value_or(OutputPlan{ImageShape{}, 0});
+  }
+
+ private:
+  std::vector<std::unique_ptr<Node>> terminals_;
+
+  std::vector<bool> finished_;
+};
+
+/**
+ * @brief Keeps track of the nodes of a pipeline that have been built, so that later nodes can consume them by name.
+ * */
+class GraphBuilder final {
+ public:
+  void Add(const std::string& name, std::unique_ptr<Node> node) { Insert(Entry{name, std::move(node), nullptr}); }
+
+  void Add(const std::string& name, std::shared_ptr<Tee> tee) { Insert(Entry{name, nullptr, std::move(tee)}); }
+
+  /**
+   * @brief Takes ownership of a node to use as the input of another node.
+   *
+   * @param name The name of the node. If empty, the node is the most recently added node.
+   *
+   * @return The node or, for a tee, a new branch of it.
+   * */
+  [[nodiscard]] auto Take(const std::string& name) -> std::unique_ptr<Node> {
+    if (entries_.empty() && name.empty()) {
+      return std::make_unique<NullNode>();
+    }
+
+    auto& entry = name.empty() ? entries_.back() : Find(name);
+
+    if (entry.tee) {
+      entry.consumed = true;
+      return entry.tee->CreateBranch();
+    }
+
+    if (entry.consumed) {
+      throw Exception("node '" + entry.name + "' is the input of more than one node, use a tee to share it");
+    }
+
+    entry.consumed = true;
+    return std::move(entry.node);
+  }
+
+  /**
+   * @brief Creates the root node, which drives every node that is not consumed by another node.
+   * */
+  [[nodiscard]] auto TakeTerminals() -> std::unique_ptr<Node> {
+    std::vector<std::unique_ptr<Node>> terminals;
+
+    for (auto& entry : entries_) {
+      if (entry.consumed) {
+        continue;
+      }
+      terminals.emplace_back(entry.tee ? entry.tee->CreateBranch() : std::move(entry.node));
+    }
+
+    if (terminals.empty()) {
+      return std::make_unique<NullNode>();
+    }
+
+    if (terminals.size() == 1) {
+      return std::move(terminals[0]);
+    }
+
+    SPDLOG_INFO("Pipeline has {} terminal nodes.", terminals.size());
+
+    return std::make_unique<TerminalGroup>(std::move(terminals));
+  }
+
+ private:
+  struct Entry final {
+    std::string name;
+
+    std::unique_ptr<Node> node;
+
+    std::shared_ptr<Tee> tee;
+
+    bool consumed{};
+  };
+
+  void Insert(Entry entry) {
+    if (entry.name.empty()) {
+      entry.name = "#" + std::to_string(entries_.size());
+    } else if (Contains(entry.name)) {
+      throw Exception("node name '" + entry.name + "' is used more than once");
+    }
+    entries_.emplace_back(std::move(entry));
+  }
+
+  [[nodiscard]] auto Contains(const std::string& name) const -> bool {
+    for (const auto& entry : entries_) {
+      if (entry.name == name) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  [[nodiscard]] auto Find(const std::string& name) -> Entry& {
+    for (auto& entry : entries_) {
+      if (entry.name == name) {
+        return entry;
+      }
+    }
+    throw Exception("unknown input node '" + name + "'");
+  }
+
+  std::vector<Entry> entries_;
 };
 
 }  // namespace
 
-auto Node::CreatePipeline(void* zmq_context, const char* config_path) -> std::unique_ptr<Node> {
+auto AnomalyScores::FromHistogram(const ResidualHistogram& histogram, const float percentile_rank) -> AnomalyScores {
+  std::uint64_t num_pixels{};
+  std::uint64_t sum{};
+  for (std::size_t i = 0; i < histogram.size(); i++) {
+    num_pixels += histogram[i];
+    sum += histogram[i] * i;
+  }
+
+  AnomalyScores scores;
+  scores.percentile_rank = percentile_rank;
+  scores.histogram = histogram;
+
+  if (num_pixels == 0) {
+    return scores;
+  }
+
+  scores.mean = static_cast<float>(sum) / static_cast<float>(num_pixels);
+
+  for (auto i = histogram.size(); i > 0; i--) {
+    if (histogram[i - 1] > 0) {
+      scores.max = static_cast<float>(i - 1);
+      break;
+    }
+  }
+
+  const auto rank = static_cast<std::uint64_t>(std::ceil(static_cast<double>(percentile_rank) * 0.01 * num_pixels));
+  std::uint64_t count{};
+  for (std::size_t i = 0; i < histogram.size(); i++) {
+    count += histogram[i];
+    if (count >= std::max<std::uint64_t>(rank, 1)) {
+      scores.percentile = static_cast<float>(i);
+      break;
+    }
+  }
+
+  return scores;
+}
+
+auto StageTimes::Name(const Stage stage) -> const char* {
+  switch (stage) {
+    case Stage::kCapture:
+      return "capture";
+    case Stage::kReceive:
+      return "receive";
+    case Stage::kDequeue:
+      return "dequeue";
+    case Stage::kTile:
+      return "tile";
+    case Stage::kNormalize:
+      return "normalize";
+    case Stage::kDetect:
+      return "detect";
+    case Stage::kBuild:
+      return "build";
+    case Stage::kSink:
+      return "sink";
+  }
+  return "unknown";
+}
+
+auto Node::LoadConfig(const char* config_path) -> pipeline::Config {
   std::ifstream file(config_path);
   if (!file.good()) {
     throw Exception("failed to open file");
@@ -52,46 +288,103 @@ auto Node::CreatePipeline(void* zmq_context, const char* config_path) -> std::un
     throw Exception(std::string(status.message()));
   }
 
+  return config;
+}
+
+void Node::PreparePipeline(Node& root, const pipeline::Config& config) {
+  if (!root.Prepare()) {
+    throw Exception("failed to prepare pipeline");
+  }
+
+  if ((config.frame_width() == 0) || (config.frame_height() == 0)) {
+    SPDLOG_WARN("No frame size configured, pipeline is not planned.");
+    return;
+  }
+
+  const auto plan = root.Plan({config.frame_width(), config.frame_height()});
+
+  SPDLOG_INFO("Planned pipeline for {}x{} frames, producing {} outputs of {}x{}x{} per frame.", config.frame_width(),
+              config.frame_height(), plan.outputs_per_frame, plan.shape.width, plan.shape.height, plan.shape.channels);
+}
+
+auto Node::CreatePipeline(void* zmq_context, const char* config_path) -> std::unique_ptr<Node> {
+  return CreatePipeline(zmq_context, LoadConfig(config_path));
+}
+
+auto Node::CreatePipeline(void* zmq_context, const pipeline::Config& config) -> std::unique_ptr<Node> {
   if (!config.enable_cv_logging()) {
     cv::utils::logging::setLogLevel(cv::utils::logging::LOG_LEVEL_SILENT);
   }
 
-  std::unique_ptr<Node> root{new NullNode()};
+  // Note: OpenCV only supports limiting the number of threads for the whole process, so it is set here once.
+  if (config.cv_threads() > 0) {
+    cv::setNumThreads(static_cast<int>(config.cv_threads()));
+  }
+
+  const auto format = (config.color_mode() == pipeline::ColorMode::GRAY) ? PixelFormat::kGray8 : PixelFormat::kRgb8;
+
+  // Note: Without load shedding, sources are stepped directly and the transport holds any backlog.
+  std::shared_ptr<LoadState> load_state;
+  if (config.has_load_shedding()) {
+    load_state = std::make_shared<LoadState>();
+  }
+
+  const auto shed = [&config, &load_state](std::unique_ptr<Node> source) -> std::unique_ptr<Node> {
+    if (!load_state) {
+      return source;
+    }
+    return LoadShedder::Create(std::move(source), config.load_shedding(), load_state);
+  };
+
+  GraphBuilder graph;
 
   for (const auto& node_config : config.pipeline()) {
-    std::unique_ptr<Node> node;
+    const auto& name = node_config.name();
+    const auto& input = node_config.input();
     switch (node_config.root_case()) {
       case pipeline::NodeConfig::kZmqSource:
         SPDLOG_INFO("Building ZMQ source node.");
-        root = ZmqSource::Create(zmq_context, node_config.zmq_source());
+        graph.Add(name, shed(ZmqSource::Create(zmq_context, node_config.zmq_source(), format)));
         break;
       case pipeline::NodeConfig::kDirectorySource:
         SPDLOG_INFO("Building directory source node.");
-        root = DirectorySource::Create(node_config.directory_source());
+        graph.Add(name, shed(DirectorySource::Create(node_config.directory_source(), format)));
+        break;
+      case pipeline::NodeConfig::kReplaySource:
+        SPDLOG_INFO("Building replay source node.");
+        graph.Add(name, shed(ReplaySource::Create(node_config.replay_source(), format)));
+        break;
+      case pipeline::NodeConfig::kSyntheticSource:
+        SPDLOG_INFO("Building synthetic source node.");
+        graph.Add(name, shed(SyntheticSource::Create(node_config.synthetic_source(), format)));
         break;
       case pipeline::NodeConfig::kDirectorySink:
         SPDLOG_INFO("Building directory sink node.");
-        root = DirectorySink::Create(std::move(root), node_config.directory_sink());
+        graph.Add(name, DirectorySink::Create(graph.Take(input), node_config.directory_sink()));
         break;
       case pipeline::NodeConfig::kTileFilter:
         SPDLOG_INFO("Building directory tile filter node.");
-        root = TileFilter::Create(std::move(root), node_config.tile_filter());
+        graph.Add(name, TileFilter::Create(graph.Take(input), node_config.tile_filter(), load_state));
         break;
       case pipeline::NodeConfig::kNormalizeFilter:
         SPDLOG_INFO("Building normalization filter node.");
-        root = NormalizeFilter::Create(std::move(root), node_config.normalize_filter());
+        graph.Add(name, NormalizeFilter::Create(graph.Take(input), node_config.normalize_filter()));
         break;
       case pipeline::NodeConfig::kDetectionFilter:
         SPDLOG_INFO("Building detection filter node.");
-        root = DetectionFilter::Create(std::move(root), node_config.detection_filter());
+        graph.Add(name, DetectionFilter::Create(graph.Take(input), node_config.detection_filter()));
         break;
       case pipeline::NodeConfig::kFrameBuilder:
         SPDLOG_INFO("Building frame builder node.");
-        root = FrameBuilder::Create(std::move(root), node_config.frame_builder());
+        graph.Add(name, FrameBuilder::Create(graph.Take(input), node_config.frame_builder()));
         break;
       case pipeline::NodeConfig::kZmqSink:
         SPDLOG_INFO("Building ZMQ sink.");
-        root = ZmqSink::Create(std::move(root), zmq_context, node_config.zmq_sink());
+        graph.Add(name, ZmqSink::Create(graph.Take(input), zmq_context, node_config.zmq_sink()));
+        break;
+      case pipeline::NodeConfig::kTee:
+        SPDLOG_INFO("Building tee node.");
+        graph.Add(name, Tee::Create(graph.Take(input), node_config.tee()));
         break;
       case pipeline::NodeConfig::ROOT_NOT_SET:
         SPDLOG_WARN("No source type set. Ignoring node.");
@@ -99,5 +392,5 @@ auto Node::CreatePipeline(void* zmq_context, const char* config_path) -> std::un
     }
   }
 
-  return root;
+  return graph.TakeTerminals();
 }
@@ -1,11 +1,125 @@
 #pragma once
 
 #include <array>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <limits>
 #include <memory>
+#include <optional>
 
 #include "image.h"
+#include "tensor.h"
+
+/**
+ * @brief The number of pixels of a residual image with each residual value.
+ * */
+using ResidualHistogram = std::array<std::uint32_t, 256>;
+
+/**
+ * @brief Summary statistics of a residual image.
+ *
+ * @details The residual of a pixel is taken to be the largest residual of its channels.
+ * */
+struct AnomalyScores final {
+  /**
+   * @brief The average residual of all pixels.
+   * */
+  float mean{};
+
+  /**
+   * @brief The largest residual of all pixels.
+   * */
+  float max{};
+
+  /**
+   * @brief The residual at the configured percentile.
+   * */
+  float percentile{};
+
+  /**
+   * @brief Whether or not the configured score exceeded the detection threshold.
+   * */
+  bool anomalous{};
+
+  /**
+   * @brief The percentile that @ref percentile was taken at, between 0 and 100.
+   * */
+  float percentile_rank{};
+
+  /**
+   * @brief The residuals that the scores were computed from, so that the scores of several images can be combined
+   * exactly.
+   * */
+  ResidualHistogram histogram{};
+
+  /**
+   * @brief Computes the mean, maximum and percentile of a histogram, but not whether they are anomalous.
+   * */
+  [[nodiscard]] static auto FromHistogram(const ResidualHistogram& histogram, float percentile_rank) -> AnomalyScores;
+};
+
+/**
+ * @brief The points in the pipeline at which the time is recorded for each output, in the order they are passed.
+ * */
+enum class Stage : std::uint8_t {
+  /**
+   * @brief The sensor captured the frame.
+   * */
+  kCapture,
+  /**
+   * @brief The source received or loaded the frame.
+   * */
+  kReceive,
+  /**
+   * @brief A load shedder passed the frame on to the pipeline.
+   * */
+  kDequeue,
+  kTile,
+  kNormalize,
+  kDetect,
+  kBuild,
+  kSink
+};
+
+constexpr std::size_t num_stages{8};
+
+/**
+ * @brief The times at which an output passed each stage of the pipeline, as far as it has.
+ *
+ * @note All times are on the steady clock of this process. The capture time is converted from the clock of the sensor
+ * when the frame is received.
+ * */
+struct StageTimes final {
+  using Clock = std::chrono::steady_clock;
+
+  std::array<Clock::time_point, num_stages> times{};
+
+  void Mark(const Stage stage) { Set(stage, Clock::now()); }
+
+  void Set(const Stage stage, const Clock::time_point time) { times[static_cast<std::size_t>(stage)] = time; }
+
+  [[nodiscard]] auto Get(const Stage stage) const -> Clock::time_point {
+    return times[static_cast<std::size_t>(stage)];
+  }
+
+  [[nodiscard]] auto Has(const Stage stage) const -> bool { return Get(stage) != Clock::time_point{}; }
+
+  /**
+   * @return The capture time if it is known, otherwise the time the source received the frame.
+   * */
+  [[nodiscard]] auto Origin() const -> std::optional<Clock::time_point> {
+    if (Has(Stage::kCapture)) {
+      return Get(Stage::kCapture);
+    }
+    if (Has(Stage::kReceive)) {
+      return Get(Stage::kReceive);
+    }
+    return std::nullopt;
+  }
+
+  [[nodiscard]] static auto Name(Stage stage) -> const char*;
+};
 
 /**
  * @brief Contains the output data of a node.
@@ -47,22 +161,112 @@ struct NodeOutput final {
    * */
   std::uint32_t frame_id{std::numeric_limits<std::uint32_t>::max()};
 
+  /**
+   * @brief The anomaly scores of the image, if it is a residual created by a detection filter.
+   * */
+  std::optional<AnomalyScores> scores;
+
+  /**
+   * @brief The network input that corresponds to the image, if it has already been prepared by a normalization
+   * filter.
+   *
+   * @note This is not carried over to outputs created from this one, since it only describes this image.
+   * */
+  std::shared_ptr<Tensor> tensor;
+
+  /**
+   * @brief The sequence number that the sensor gave the frame, or zero if the sensor did not send one.
+   * */
+  std::uint64_t sequence{};
+
+  /**
+   * @brief The times at which the frame that the image belongs to passed each stage of the pipeline.
+   * */
+  StageTimes times;
+
   NodeOutput() = default;
 
   NodeOutput(std::shared_ptr<Image> img, uint32_t frame_id_)
       : image(std::move(img)), offset{0, 0}, size{image->Width(), image->Height()}, frame_id(frame_id_) {}
 
   NodeOutput(std::shared_ptr<Image> img, const NodeOutput& child)
-      : image(std::move(img)), offset(child.offset), size(child.size), frame_id(child.frame_id) {}
+      : image(std::move(img)), offset(child.offset), size(child.size), frame_id(child.frame_id), scores(child.scores),
+        sequence(child.sequence), times(child.times) {}
 
   [[nodiscard]] auto EndOfStream() const -> bool { return frame_id == std::numeric_limits<std::uint32_t>::max(); }
 };
 
+/**
+ * @brief What a node will output, as worked out by the planning pass.
+ * */
+struct OutputPlan final {
+  /**
+   * @brief The shape of the images that the node outputs.
+   * */
+  ImageShape shape;
+
+  /**
+   * @brief The number of outputs that the node produces for each frame.
+   * */
+  std::size_t outputs_per_frame{1};
+};
+
+namespace pipeline {
+class Config;
+}  // namespace pipeline
+
 class Node {
  public:
+  /**
+   * @brief Reads a pipeline configuration from a JSON file.
+   * */
+  static auto LoadConfig(const char* config_path) -> pipeline::Config;
+
+  static auto CreatePipeline(void* zmq_context, const pipeline::Config& config) -> std::unique_ptr<Node>;
+
   static auto CreatePipeline(void* zmq_context, const char* config_path) -> std::unique_ptr<Node>;
 
+  /**
+   * @brief Prepares a pipeline and, if the configuration gives the frame size, plans it.
+   *
+   * @throws Exception If the pipeline cannot be prepared or fails its plan.
+   * */
+  static void PreparePipeline(Node& root, const pipeline::Config& config);
+
   virtual ~Node() = default;
 
   [[nodiscard]] virtual auto Step() -> NodeOutput = 0;
+
+  /**
+   * @brief Does the work that would otherwise be done by the first step, such as loading models.
+   *
+   * @details Filters prepare the nodes they consume first.
+   *
+   * @return False if this node or a node it consumes is unable to run.
+   * */
+  [[nodiscard]] virtual auto Prepare() -> bool { return true; }
+
+  /**
+   * @brief Makes the sources of the pipeline end their streams.
+   *
+   * @details Outputs that are already in progress are still returned by the following steps, after which the
+   * pipeline reaches the end of its stream. Filters forward this to the nodes they consume. Sources may be closed
+   * from another thread than the one that steps them, and end a step that is waiting for input.
+   * */
+  virtual void Close() {}
+
+  /**
+   * @brief Checks ahead of time that the node can process frames of a given size, and reserves the buffers that it
+   * needs to process them.
+   *
+   * @details Filters plan the nodes they consume first, and check the plan of their input against their own
+   * configuration. This should be called after @ref Node::Prepare.
+   *
+   * @param frame_size The width and height of the frames that the sources produce.
+   *
+   * @return What the node will output.
+   *
+   * @throws Exception If the node cannot process the outputs of the nodes it consumes.
+   * */
+  [[nodiscard]] virtual auto Plan(const std::array<std::uint32_t, 2>& frame_size) -> OutputPlan = 0;
 };
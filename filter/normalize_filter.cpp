@@ -1,7 +1,11 @@
 #include "normalize_filter.h"
 
+#include <algorithm>
 #include <cmath>
 
+#include "buffer_pool.h"
+#include "tensor.h"
+
 namespace {
 
 class NormalizeFilterImpl final : public NormalizeFilter {
@@ -15,78 +19,173 @@ class NormalizeFilterImpl final : public NormalizeFilter {
       return child_output;
     }
 
-    auto output_img = std::make_shared<Image>(child_output.image->Width(), child_output.image->Height());
+    const auto& input = *child_output.image;
+
+    auto output_img = image_pool_->Acquire(input.Shape(), input.Shape());
+
+    // Note: With a tensor, the 8-bit image is still written from the same statistics, since the detection filter
+    //       compares the prediction against it. Otherwise the scores would depend on the input format.
+    std::shared_ptr<Tensor> tensor;
+    if (config_.tensor_output()) {
+      const std::array<std::uint32_t, 3> tensor_shape{input.Channels(), input.Height(), input.Width()};
+      tensor = tensor_pool_->Acquire(tensor_shape, input.Channels(), input.Height(), input.Width());
+    }
 
     switch (config_.kind()) {
-      case pipeline::Normalization::STANDARD:
-        NormalizeStandard(*child_output.image, *output_img);
+      case pipeline::Normalization::STANDARD: {
+        const auto moments = ComputeMoments(input);
+        NormalizeStandard(input, moments, *output_img);
+        if (tensor) {
+          NormalizeStandard(input, moments, *tensor);
+        }
         break;
-      case pipeline::Normalization::MIN_MAX:
-        NormalizeMinMax(*child_output.image, *output_img);
+      }
+      case pipeline::Normalization::MIN_MAX: {
+        int min_v{};
+        int max_v{};
+        MinMax(input, min_v, max_v);
+        NormalizeMinMax(input, min_v, max_v, *output_img);
+        if (tensor) {
+          NormalizeMinMax(input, min_v, max_v, *tensor);
+        }
         break;
+      }
     }
 
-    return NodeOutput(std::move(output_img), child_output);
+    auto self_output = NodeOutput(std::move(output_img), child_output);
+    self_output.tensor = std::move(tensor);
+    self_output.times.Mark(Stage::kNormalize);
+    return self_output;
+  }
+
+  [[nodiscard]] auto Prepare() -> bool override { return child_->Prepare(); }
+
+  void Close() override { child_->Close(); }
+
+  /**
+   * @note Two frames worth of outputs are reserved, since a later node may keep the outputs of one frame while the
+   * next is processed.
+   * */
+  [[nodiscard]] auto Plan(const std::array<std::uint32_t, 2>& frame_size) -> OutputPlan override {
+    const auto plan = child_->Plan(frame_size);
+    const auto& shape = plan.shape;
+
+    image_pool_->Reserve(shape, plan.outputs_per_frame * 2, shape);
+    if (config_.tensor_output()) {
+      tensor_pool_->Reserve({shape.channels, shape.height, shape.width}, plan.outputs_per_frame * 2, shape.channels,
+                            shape.height, shape.width);
+    }
+
+    return plan;
   }
 
  protected:
-  static auto Sum(const Image& img) -> float {
-    auto sum{0.0F};
-    const auto num_pixels = img.Width() * img.Height() * 3;
-    const auto* data = img.Data();
-    for (std::size_t i = 0; i < num_pixels; i++) {
-      sum += static_cast<float>(data[i]);
+  struct Moments final {
+    float mean{};
+
+    float stddev{};
+  };
+
+  /**
+   * @brief Computes the mean and standard deviation of all channel values in one pass.
+   * */
+  static auto ComputeMoments(const Image& img) -> Moments {
+    auto sum{0.0};
+    auto sum_sq{0.0};
+    const auto row_size = img.RowSize();
+    for (std::uint32_t y = 0; y < img.Height(); y++) {
+      const auto* data = img.Row(y);
+      for (std::size_t i = 0; i < row_size; i++) {
+        const auto value = static_cast<double>(data[i]);
+        sum += value;
+        sum_sq += value * value;
+      }
     }
-    return sum;
+    const auto n = static_cast<double>(row_size * img.Height());
+    const auto mean = sum / n;
+    const auto variance = std::max((sum_sq / n) - (mean * mean), 0.0);
+    return Moments{static_cast<float>(mean), static_cast<float>(std::sqrt(variance))};
   }
 
-  static auto Stddev(const Image& img, const float avg) -> float {
-    auto sum{0.0F};
-    const auto num_pixels = img.Width() * img.Height() * 3;
-    const auto* data = img.Data();
-    for (std::size_t i = 0; i < num_pixels; i++) {
-      const auto delta = static_cast<float>(data[i]) - avg;
-      sum += delta * delta;
+  static void MinMax(const Image& input, int& min_v, int& max_v) {
+    min_v = 255;
+    max_v = 0;
+    const auto row_size = input.RowSize();
+    for (std::uint32_t y = 0; y < input.Height(); y++) {
+      const auto* data = input.Row(y);
+      for (std::size_t i = 0; i < row_size; i++) {
+        min_v = std::min(min_v, static_cast<int>(data[i]));
+        max_v = std::max(max_v, static_cast<int>(data[i]));
+      }
     }
-    return std::sqrt(sum / static_cast<float>(num_pixels));
   }
 
-  static void NormalizeStandard(const Image& input, Image& output) {
-    const auto sum = Sum(input);
-    const auto avg = sum / static_cast<float>(input.Width() * input.Height() * 3);
-    const auto stddev = Stddev(input, avg);
-    const auto num_pixels = input.Width() * input.Height() * 3;
-    auto* dst = output.Data();
-    const auto* src = input.Data();
-    const auto scale = 1.0F / stddev;
-    for (std::size_t i = 0; i < num_pixels; i++) {
-      const auto value = static_cast<int>((((static_cast<float>(src[i]) - avg) * scale) + 1.0F) * 0.5F * 255.0F);
-      dst[i] = static_cast<std::uint8_t>(std::clamp(value, 0, 255));
+  /**
+   * @brief Writes each channel value of an image to its plane of the tensor as `(value - offset) * scale`, clamped to
+   * the range of 0 to 1.
+   * */
+  static void WriteTensor(const Image& input, const float offset, const float scale, Tensor& output) {
+    const auto channels = input.Channels();
+    const auto w = input.Width();
+    for (std::uint32_t y = 0; y < input.Height(); y++) {
+      const auto* src = input.Row(y);
+      for (std::uint32_t c = 0; c < channels; c++) {
+        auto* dst = output.Plane(c) + y * w;
+        for (std::uint32_t x = 0; x < w; x++) {
+          const auto value = (static_cast<float>(src[x * channels + c]) - offset) * scale;
+          dst[x] = std::clamp(value, 0.0F, 1.0F);
+        }
+      }
     }
   }
 
-  static void NormalizeMinMax(const Image& input, Image& output) {
-    auto min_v{255};
-    auto max_v{0};
-    const auto num_pixels = input.Width() * input.Height() * 3;
-    const auto* data = input.Data();
-    for (std::size_t i = 0; i < num_pixels; i++) {
-      min_v = std::min(min_v, static_cast<int>(data[i]));
-      max_v = std::max(max_v, static_cast<int>(data[i]));
+  static void NormalizeStandard(const Image& input, const Moments& moments, Tensor& output) {
+    // Note: This is the same mapping as the 8-bit output, without the quantization.
+    const auto scale = 0.5F / moments.stddev;
+    WriteTensor(input, moments.mean - moments.stddev, scale, output);
+  }
+
+  static void NormalizeMinMax(const Image& input, const int min_v, const int max_v, Tensor& output) {
+    const auto scale = (max_v == min_v) ? 1.0F : (1.0F / static_cast<float>(max_v - min_v));
+    WriteTensor(input, static_cast<float>(min_v), scale, output);
+  }
+
+  static void NormalizeStandard(const Image& input, const Moments& moments, Image& output) {
+    const auto row_size = input.RowSize();
+    const auto avg = moments.mean;
+    const auto scale = 1.0F / moments.stddev;
+    for (std::uint32_t y = 0; y < input.Height(); y++) {
+      auto* dst = output.Row(y);
+      const auto* src = input.Row(y);
+      for (std::size_t i = 0; i < row_size; i++) {
+        const auto value = static_cast<int>((((static_cast<float>(src[i]) - avg) * scale) + 1.0F) * 0.5F * 255.0F);
+        dst[i] = static_cast<std::uint8_t>(std::clamp(value, 0, 255));
+      }
     }
+  }
+
+  static void NormalizeMinMax(const Image& input, const int min_v, const int max_v, Image& output) {
+    const auto row_size = input.RowSize();
 
     const auto scale = (max_v == min_v) ? 255.0F : (255.0F / static_cast<float>(max_v - min_v));
 
-    auto* dst = output.Data();
-    for (std::size_t i = 0; i < num_pixels; i++) {
-      const auto value = static_cast<int>((static_cast<float>(data[i]) - static_cast<float>(min_v)) * scale);
-      dst[i] = static_cast<std::uint8_t>(std::clamp(value, 0, 255));
+    for (std::uint32_t y = 0; y < input.Height(); y++) {
+      auto* dst = output.Row(y);
+      const auto* data = input.Row(y);
+      for (std::size_t i = 0; i < row_size; i++) {
+        const auto value = static_cast<int>((static_cast<float>(data[i]) - static_cast<float>(min_v)) * scale);
+        dst[i] = static_cast<std::uint8_t>(std::clamp(value, 0, 255));
+      }
     }
   }
 
  private:
   std::unique_ptr<Node> child_;
 
+  std::shared_ptr<ImagePool> image_pool_{ImagePool::Create()};
+
+  std::shared_ptr<TensorPool> tensor_pool_{TensorPool::Create()};
+
   pipeline::NormalizeFilterConfig config_;
 };
 
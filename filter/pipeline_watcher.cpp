@@ -0,0 +1,114 @@
+#include "pipeline_watcher.h"
+
+#include <spdlog/spdlog.h>
+
+#include <system_error>
+#include <utility>
+
+#include "exception.h"
+
+PipelineWatcher::PipelineWatcher(void* zmq_context, std::string config_path, const pipeline::Config& config)
+    : zmq_context_(zmq_context),
+      config_path_(std::move(config_path)),
+      interval_((config.reload_interval_ms() == 0) ? 1000 : config.reload_interval_ms()),
+      files_(WatchedFiles(config)),
+      stamps_(ReadStamps(files_)) {
+  for (const auto& path : files_) {
+    SPDLOG_INFO("Watching '{}' for changes.", path);
+  }
+  thread_ = std::thread([this]() { Run(); });
+}
+
+PipelineWatcher::~PipelineWatcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  stop_condition_.notify_all();
+  thread_.join();
+}
+
+auto PipelineWatcher::TakePipeline() -> std::unique_ptr<Node> {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::move(ready_);
+}
+
+auto PipelineWatcher::WatchedFiles(const pipeline::Config& config) const -> std::vector<std::string> {
+  std::vector<std::string> paths{config_path_};
+  for (const auto& node_config : config.pipeline()) {
+    if (node_config.has_detection_filter()) {
+      paths.emplace_back(node_config.detection_filter().model());
+    }
+  }
+  return paths;
+}
+
+auto PipelineWatcher::ReadStamps(const std::vector<std::string>& paths) -> Stamps {
+  Stamps stamps;
+  for (const auto& path : paths) {
+    std::error_code time_err;
+    std::error_code size_err;
+    const auto time = std::filesystem::last_write_time(path, time_err);
+    const auto size = std::filesystem::file_size(path, size_err);
+    if (time_err || size_err) {
+      stamps[path] = std::nullopt;
+    } else {
+      stamps[path] = FileStamp{time, size};
+    }
+  }
+  return stamps;
+}
+
+void PipelineWatcher::Run() {
+  std::optional<Stamps> candidate;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (stop_condition_.wait_for(lock, interval_, [this]() { return stop_; })) {
+        return;
+      }
+    }
+
+    auto current = ReadStamps(files_);
+    if (current == stamps_) {
+      candidate.reset();
+      continue;
+    }
+
+    // Note: The files are only read once they have not changed for a whole interval, so that a model that is still
+    //       being written is not loaded.
+    if (!candidate || (*candidate != current)) {
+      candidate = std::move(current);
+      continue;
+    }
+
+    stamps_ = std::move(*candidate);
+    candidate.reset();
+
+    Rebuild();
+  }
+}
+
+void PipelineWatcher::Rebuild() {
+  SPDLOG_INFO("Pipeline files changed, building new pipeline.");
+
+  std::unique_ptr<Node> root;
+
+  try {
+    const auto config = Node::LoadConfig(config_path_.c_str());
+    root = Node::CreatePipeline(zmq_context_, config);
+    Node::PreparePipeline(*root, config);
+    files_ = WatchedFiles(config);
+    stamps_ = ReadStamps(files_);
+  } catch (const Exception& e) {
+    SPDLOG_ERROR("Failed to build new pipeline, keeping the current one: '{}'", e.what());
+    return;
+  }
+
+  SPDLOG_INFO("New pipeline is ready.");
+
+  // Note: If the previous pipeline was never taken, it is destroyed after the lock is released.
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::swap(ready_, root);
+}
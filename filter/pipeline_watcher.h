@@ -0,0 +1,83 @@
+#pragma once
+
+#include <pipeline/config.pb.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "node.h"
+
+/**
+ * @brief Watches the pipeline configuration and the model files, and builds a new pipeline when they change.
+ *
+ * @details The new pipeline is built and prepared on a background thread, so the running pipeline does not have to
+ * wait for models to load. If the new pipeline fails to build or prepare, it is discarded and the running pipeline is
+ * kept until the files change again.
+ * */
+class PipelineWatcher final {
+ public:
+  /**
+   * @param config The configuration of the running pipeline, which names the model files to watch.
+   * */
+  PipelineWatcher(void* zmq_context, std::string config_path, const pipeline::Config& config);
+
+  PipelineWatcher(const PipelineWatcher&) = delete;
+
+  ~PipelineWatcher();
+
+  auto operator=(const PipelineWatcher&) -> PipelineWatcher& = delete;
+
+  /**
+   * @brief Takes the most recently built pipeline, if there is one. Does not block.
+   * */
+  [[nodiscard]] auto TakePipeline() -> std::unique_ptr<Node>;
+
+ protected:
+  struct FileStamp final {
+    std::filesystem::file_time_type time;
+
+    std::uintmax_t size{};
+
+    [[nodiscard]] auto operator==(const FileStamp&) const -> bool = default;
+  };
+
+  using Stamps = std::map<std::string, std::optional<FileStamp>>;
+
+  [[nodiscard]] auto WatchedFiles(const pipeline::Config& config) const -> std::vector<std::string>;
+
+  [[nodiscard]] static auto ReadStamps(const std::vector<std::string>& paths) -> Stamps;
+
+  void Run();
+
+  void Rebuild();
+
+ private:
+  void* zmq_context_{};
+
+  std::string config_path_;
+
+  std::chrono::milliseconds interval_;
+
+  std::vector<std::string> files_;
+
+  Stamps stamps_;
+
+  std::mutex mutex_;
+
+  std::condition_variable stop_condition_;
+
+  bool stop_{};
+
+  std::unique_ptr<Node> ready_;
+
+  std::thread thread_;
+};
@@ -0,0 +1,107 @@
+#include "recording.h"
+
+#include <spdlog/spdlog.h>
+
+#include <array>
+#include <chrono>
+
+namespace {
+
+constexpr std::array<char, 4> file_magic{'A', 'D', 'R', 'C'};
+
+constexpr std::uint32_t file_version{1};
+
+struct FileHeader final {
+  std::array<char, 4> magic{file_magic};
+
+  std::uint32_t version{file_version};
+};
+
+struct MessageHeader final {
+  std::int64_t receive_time_us{};
+
+  std::uint64_t size{};
+};
+
+}  // namespace
+
+RecordingWriter::RecordingWriter(const std::string& path) : file_(path, std::ios::binary | std::ios::trunc) {
+  if (!file_.good()) {
+    SPDLOG_ERROR("Failed to create recording '{}'.", path);
+    return;
+  }
+
+  const FileHeader header;
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  SPDLOG_INFO("Recording received messages to '{}'.", path);
+}
+
+void RecordingWriter::Write(const void* data, const std::size_t size) {
+  if (!file_.good()) {
+    return;
+  }
+
+  const MessageHeader header{std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::system_clock::now().time_since_epoch())
+                                 .count(),
+                             size};
+
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+
+  if (!file_.good()) {
+    SPDLOG_ERROR("Failed to write to recording, stopping after {} messages.", num_messages_);
+    return;
+  }
+
+  num_messages_++;
+}
+
+void RecordingWriter::Flush() { file_.flush(); }
+
+RecordingReader::RecordingReader(const std::string& path) : file_(path, std::ios::binary) {
+  if (!file_.good()) {
+    SPDLOG_ERROR("Failed to open recording '{}'.", path);
+    return;
+  }
+
+  FileHeader header;
+  if (!file_.read(reinterpret_cast<char*>(&header), sizeof(header)) || (header.magic != file_magic) ||
+      (header.version != file_version)) {
+    SPDLOG_ERROR("'{}' is not a recording.", path);
+    return;
+  }
+
+  first_message_ = file_.tellg();
+  valid_ = true;
+}
+
+auto RecordingReader::Next(RecordedMessage& message) -> bool {
+  if (!valid_) {
+    return false;
+  }
+
+  MessageHeader header;
+  if (!file_.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+    return false;
+  }
+
+  message.receive_time_us = header.receive_time_us;
+  message.payload.resize(header.size);
+
+  if (!file_.read(reinterpret_cast<char*>(message.payload.data()), static_cast<std::streamsize>(header.size))) {
+    SPDLOG_WARN("Recording ends in the middle of a message.");
+    return false;
+  }
+
+  return true;
+}
+
+void RecordingReader::Rewind() {
+  if (!valid_) {
+    return;
+  }
+  file_.clear();
+  file_.seekg(first_message_);
+}
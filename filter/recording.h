@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A message that a source received, as stored in a recording.
+ * */
+struct RecordedMessage final {
+  /**
+   * @brief The time at which the message was received, in microseconds since the Unix epoch.
+   * */
+  std::int64_t receive_time_us{};
+
+  /**
+   * @brief The message as it was received, including the frame header if the sensor sent one.
+   * */
+  std::vector<std::uint8_t> payload;
+};
+
+/**
+ * @brief Writes the messages that a source receives to a file, so that they can be played back later.
+ *
+ * @details A recording starts with a file header, followed by each message as its receive time, its size and its
+ * payload. All numbers are in the byte order of the host.
+ * */
+class RecordingWriter final {
+ public:
+  /**
+   * @note If the file cannot be created, an error is logged and nothing is recorded.
+   * */
+  explicit RecordingWriter(const std::string& path);
+
+  /**
+   * @brief Appends a message to the recording, with the current time as its receive time.
+   * */
+  void Write(const void* data, std::size_t size);
+
+  /**
+   * @brief Writes any buffered messages to the file.
+   * */
+  void Flush();
+
+  [[nodiscard]] auto NumMessages() const -> std::uint64_t { return num_messages_; }
+
+ private:
+  std::ofstream file_;
+
+  std::uint64_t num_messages_{};
+};
+
+/**
+ * @brief Reads the messages of a recording in the order they were received.
+ * */
+class RecordingReader final {
+ public:
+  /**
+   * @note If the file cannot be opened or is not a recording, an error is logged and no messages are read.
+   * */
+  explicit RecordingReader(const std::string& path);
+
+  /**
+   * @brief Reads the next message, reusing the memory of the given one.
+   *
+   * @return False if there are no more messages.
+   * */
+  [[nodiscard]] auto Next(RecordedMessage& message) -> bool;
+
+  /**
+   * @brief Goes back to the first message.
+   * */
+  void Rewind();
+
+ private:
+  std::ifstream file_;
+
+  std::streampos first_message_{};
+
+  bool valid_{};
+};
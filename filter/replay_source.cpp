@@ -0,0 +1,201 @@
+#include "replay_source.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <thread>
+
+#include "buffer_pool.h"
+#include "frame_header.h"
+#include "recording.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief How often to log the achieved frame rate.
+ * */
+constexpr std::chrono::seconds stats_interval{10};
+
+/**
+ * @brief The number of frames that are reserved: the one being decoded, one queued by a load shedder, and the ones
+ * that downstream nodes still hold.
+ * */
+constexpr std::size_t reserved_frames{4};
+
+class ReplaySourceImpl final : public ReplaySource {
+ public:
+  ReplaySourceImpl(const pipeline::ReplaySourceConfig& config, const PixelFormat format)
+      : config_(config),
+        reader_(config.path()),
+        speed_((config.speed() > 0.0F) ? config.speed() : 1.0F),
+        format_(format) {
+    if (config_.max_speed()) {
+      SPDLOG_INFO("Replaying '{}' as fast as possible.", config_.path());
+    } else {
+      SPDLOG_INFO("Replaying '{}' at {}x the recorded speed.", config_.path(), speed_);
+    }
+  }
+
+  [[nodiscard]] auto Step() -> NodeOutput override {
+    if (closed_) {
+      LogStats(Clock::now());
+      return NodeOutput();
+    }
+
+    if (!reader_.Next(message_)) {
+      if (!config_.loop() || (frame_id_ == 0)) {
+        LogStats(Clock::now());
+        return NodeOutput();
+      }
+      // Note: The timing starts over with the loop, so that the gap between the last and first frame is not waited.
+      reader_.Rewind();
+      start_.reset();
+      if (!reader_.Next(message_)) {
+        return NodeOutput();
+      }
+    }
+
+    WaitUntilDue();
+
+    const auto* data = message_.payload.data();
+    auto size = message_.payload.size();
+
+    const auto header = FrameHeader::Parse(data, size);
+    if (header) {
+      data += sizeof(FrameHeader);
+      size -= sizeof(FrameHeader);
+    }
+
+    auto img = DecodePooled(*frame_pool_, data, size, format_);
+    if (!img) {
+      SPDLOG_ERROR("Failed to load recorded image.");
+      return NodeOutput();
+    }
+
+    auto output = NodeOutput(std::move(img), frame_id_);
+    output.times.Mark(Stage::kReceive);
+
+    if (header) {
+      // Note: The delay between capture and receipt is taken from the recording, since the capture time itself has
+      //       long passed.
+      const auto delay = std::max(message_.receive_time_us - header->capture_time_us, std::int64_t{0});
+      output.sequence = header->sequence;
+      output.times.Set(Stage::kCapture, output.times.Get(Stage::kReceive) - std::chrono::microseconds(delay));
+    }
+
+    frame_id_++;
+    num_frames_++;
+
+    const auto now = Clock::now();
+    if ((now - last_stats_) >= stats_interval) {
+      LogStats(now);
+    }
+
+    return output;
+  }
+
+  void Close() override { closed_ = true; }
+
+  [[nodiscard]] auto Plan(const std::array<std::uint32_t, 2>& frame_size) -> OutputPlan override {
+    const ImageShape shape{frame_size[0], frame_size[1], Image::FormatChannels(format_), format_};
+    frame_pool_->Reserve(shape, reserved_frames, shape);
+    return OutputPlan{shape, 1};
+  }
+
+ protected:
+  /**
+   * @brief Sleeps until the current message is due, by the time it was received at relative to the first message.
+   * */
+  void WaitUntilDue() {
+    if (!start_) {
+      start_ = Start{Clock::now(), message_.receive_time_us};
+      if (!first_start_) {
+        first_start_ = start_->time;
+        last_stats_ = start_->time;
+      }
+      return;
+    }
+
+    if (config_.max_speed()) {
+      return;
+    }
+
+    const auto recorded = std::chrono::microseconds(message_.receive_time_us - start_->receive_time_us);
+    const auto due = start_->time + std::chrono::duration_cast<Clock::duration>(recorded / static_cast<double>(speed_));
+
+    // Note: If the pipeline falls behind, frames are played back late rather than dropped, so that every run sees the
+    //       same frames.
+    std::this_thread::sleep_until(due);
+  }
+
+  /**
+   * @brief Logs the frame rate achieved since the last call.
+   * */
+  void LogStats(const Clock::time_point now) {
+    if (!first_start_ || (num_frames_ == 0)) {
+      return;
+    }
+    const auto elapsed = std::chrono::duration<double>(now - last_stats_).count();
+    const auto total = std::chrono::duration<double>(now - *first_start_).count();
+    if ((elapsed <= 0.0) || (total <= 0.0)) {
+      return;
+    }
+    SPDLOG_INFO("Replayed {} frames at {:.1f} fps ({} in total at {:.1f} fps).", num_frames_,
+                static_cast<double>(num_frames_) / elapsed, frame_id_, static_cast<double>(frame_id_) / total);
+    num_frames_ = 0;
+    last_stats_ = now;
+  }
+
+ private:
+  struct Start final {
+    /**
+     * @brief When the first message of the current pass was played back.
+     * */
+    Clock::time_point time;
+
+    /**
+     * @brief When the first message of the current pass was received during recording.
+     * */
+    std::int64_t receive_time_us{};
+  };
+
+  pipeline::ReplaySourceConfig config_;
+
+  RecordingReader reader_;
+
+  RecordedMessage message_;
+
+  float speed_{1.0F};
+
+  PixelFormat format_{PixelFormat::kRgb8};
+
+  std::shared_ptr<ImagePool> frame_pool_{ImagePool::Create()};
+
+  std::optional<Start> start_;
+
+  std::optional<Clock::time_point> first_start_;
+
+  Clock::time_point last_stats_;
+
+  std::uint32_t frame_id_{};
+
+  /**
+   * @brief The number of frames played back since the frame rate was last logged.
+   * */
+  std::uint64_t num_frames_{};
+
+  std::atomic<bool> closed_{};
+};
+
+}  // namespace
+
+auto ReplaySource::Create(const pipeline::ReplaySourceConfig& config, const PixelFormat format)
+    -> std::unique_ptr<ReplaySource> {
+  return std::make_unique<ReplaySourceImpl>(config, format);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <pipeline/replay_source_config.pb.h>
+
+#include <memory>
+
+#include "node.h"
+
+/**
+ * @brief Plays back a stream that a ZMQ source recorded, at the recorded speed, at a multiple of it, or as fast as
+ * the pipeline takes the frames.
+ *
+ * @details Frames are decoded the same way that the ZMQ source decodes them. If the sensor sent capture times, each
+ * frame keeps the delay between its capture and its receipt, so that end-to-end latency stays comparable. The
+ * achieved frame rate is logged periodically and at the end of the stream.
+ * */
+class ReplaySource : public Node {
+ public:
+  /**
+   * @param format The format to decode the recorded images to.
+   * */
+  static auto Create(const pipeline::ReplaySourceConfig& config, PixelFormat format) -> std::unique_ptr<ReplaySource>;
+
+  ~ReplaySource() override = default;
+};
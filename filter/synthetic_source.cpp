@@ -0,0 +1,227 @@
+#include "synthetic_source.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer_pool.h"
+#include "exception.h"
+#include "synthetic_anomalies.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief The number of frames that are reserved: the one being drawn, one queued by a load shedder, and the ones that
+ * downstream nodes still hold.
+ * */
+constexpr std::size_t reserved_frames{4};
+
+class SyntheticSourceImpl final : public SyntheticSource {
+ public:
+  SyntheticSourceImpl(const pipeline::SyntheticSourceConfig& config, const PixelFormat format)
+      : config_(config), format_(format), rng_(config.seed()) {
+    if ((config_.anomaly_probability() < 0.0F) || (config_.anomaly_probability() > 1.0F)) {
+      throw Exception("Anomaly probability must be between 0 and 1.");
+    }
+
+    if (config_.fps() < 0.0F) {
+      throw Exception("Frame rate cannot be negative.");
+    }
+
+    CreateBackground();
+
+    min_size_ = (config_.min_anomaly_size() > 0) ? static_cast<int>(config_.min_anomaly_size())
+                                                 : synthetic::default_min_anomaly_size;
+    max_size_ = (config_.max_anomaly_size() > 0) ? static_cast<int>(config_.max_anomaly_size())
+                                                 : synthetic::default_max_anomaly_size;
+    max_size_ = std::min({max_size_, background_.cols, background_.rows});
+    if (min_size_ > max_size_) {
+      throw Exception("Anomalies of at least " + std::to_string(min_size_) + " pixels do not fit into " +
+                      std::to_string(background_.cols) + "x" + std::to_string(background_.rows) + " frames.");
+    }
+
+    // Note: The values of the kinds in the configuration match the shared enum.
+    for (const auto kind : config_.anomaly_kinds()) {
+      kinds_.emplace_back(static_cast<synthetic::AnomalyKind>(kind));
+    }
+    if (kinds_.empty()) {
+      kinds_ = synthetic::all_kinds;
+    }
+
+    if (!config_.ground_truth_path().empty()) {
+      ground_truth_.open(config_.ground_truth_path(), std::ios::trunc);
+      if (!ground_truth_) {
+        throw Exception("Failed to open '" + config_.ground_truth_path() + "' for the ground truth.");
+      }
+    }
+
+    SPDLOG_INFO("Generating {}x{} frames with an anomaly probability of {}.", background_.cols, background_.rows,
+                config_.anomaly_probability());
+  }
+
+  [[nodiscard]] auto Step() -> NodeOutput override {
+    if (closed_ || ((config_.num_frames() > 0) && (frame_id_ >= config_.num_frames()))) {
+      Finish();
+      return NodeOutput();
+    }
+
+    WaitUntilDue();
+
+    const auto shape = Shape();
+    auto img = frame_pool_->Acquire(shape, shape);
+    if (img->Empty()) {
+      SPDLOG_ERROR("Failed to allocate synthetic frame.");
+      return NodeOutput();
+    }
+
+    cv::Mat frame(background_.rows, background_.cols, background_.type(), img->Data(), img->Stride());
+
+    synthetic::DrawBackground(background_, config_.static_background() ? 0 : frame_id_, frame);
+
+    synthetic::DrawAnomalies(frame, config_.anomaly_probability(), config_.max_anomalies(), kinds_, min_size_,
+                             max_size_, rng_, anomalies_);
+    if (!anomalies_.empty()) {
+      num_anomalous_frames_++;
+      num_anomalies_ += anomalies_.size();
+    }
+
+    if (ground_truth_.is_open()) {
+      ground_truth_ << synthetic::GroundTruthJson(frame_id_, anomalies_) << '\n';
+    }
+
+    auto output = NodeOutput(std::move(img), frame_id_);
+    output.sequence = frame_id_;
+    output.times.Mark(Stage::kCapture);
+    output.times.Set(Stage::kReceive, output.times.Get(Stage::kCapture));
+
+    frame_id_++;
+
+    return output;
+  }
+
+  void Close() override { closed_ = true; }
+
+  [[nodiscard]] auto Plan(const std::array<std::uint32_t, 2>&) -> OutputPlan override {
+    const auto shape = Shape();
+    frame_pool_->Reserve(shape, reserved_frames, shape);
+    return OutputPlan{shape, 1};
+  }
+
+ protected:
+  [[nodiscard]] auto Shape() const -> ImageShape {
+    return ImageShape{static_cast<std::uint32_t>(background_.cols), static_cast<std::uint32_t>(background_.rows),
+                      Image::FormatChannels(format_), format_};
+  }
+
+  void CreateBackground() {
+    const auto channels = static_cast<int>(Image::FormatChannels(format_));
+
+    if (!config_.base_image().empty()) {
+      Image base;
+      if (!base.Load(config_.base_image().c_str(), format_)) {
+        throw Exception("Failed to load base image '" + config_.base_image() + "'.");
+      }
+      const cv::Mat view(static_cast<int>(base.Height()), static_cast<int>(base.Width()), CV_8UC(channels),
+                         base.Data(), base.Stride());
+      const auto w = (config_.width() > 0) ? static_cast<int>(config_.width()) : view.cols;
+      const auto h = (config_.height() > 0) ? static_cast<int>(config_.height()) : view.rows;
+      if ((w == view.cols) && (h == view.rows)) {
+        background_ = view.clone();
+      } else {
+        cv::resize(view, background_, cv::Size(w, h), 0, 0, cv::INTER_AREA);
+      }
+      return;
+    }
+
+    const auto w = (config_.width() > 0) ? static_cast<int>(config_.width()) : 640;
+    const auto h = (config_.height() > 0) ? static_cast<int>(config_.height()) : 480;
+    background_ = synthetic::ProceduralTexture(w, h, channels, config_.seed());
+  }
+
+  /**
+   * @brief Sleeps until the next frame is due at the configured frame rate.
+   * */
+  void WaitUntilDue() {
+    const auto now = Clock::now();
+    if (!start_) {
+      start_ = now;
+      return;
+    }
+    if (config_.fps() <= 0.0F) {
+      return;
+    }
+    const auto due = *start_ + std::chrono::duration_cast<Clock::duration>(
+                                   std::chrono::duration<double>(frame_id_ / static_cast<double>(config_.fps())));
+    std::this_thread::sleep_until(due);
+  }
+
+  /**
+   * @brief Logs what was generated, once the stream has ended.
+   * */
+  void Finish() {
+    if (finished_) {
+      return;
+    }
+    finished_ = true;
+    ground_truth_.flush();
+    const auto elapsed = start_ ? std::chrono::duration<double>(Clock::now() - *start_).count() : 0.0;
+    SPDLOG_INFO("Generated {} frames ({:.1f} fps), {} of them with {} anomalies in total.", frame_id_,
+                (elapsed > 0.0) ? (frame_id_ / elapsed) : 0.0, num_anomalous_frames_, num_anomalies_);
+  }
+
+ private:
+  pipeline::SyntheticSourceConfig config_;
+
+  PixelFormat format_{PixelFormat::kRgb8};
+
+  std::mt19937_64 rng_;
+
+  cv::Mat background_;
+
+  std::shared_ptr<ImagePool> frame_pool_{ImagePool::Create()};
+
+  std::vector<synthetic::AnomalyKind> kinds_;
+
+  /**
+   * @brief The anomalies of the current frame, kept to reuse their storage.
+   * */
+  std::vector<synthetic::Anomaly> anomalies_;
+
+  int min_size_{};
+
+  int max_size_{};
+
+  std::ofstream ground_truth_;
+
+  std::optional<Clock::time_point> start_;
+
+  std::uint32_t frame_id_{};
+
+  std::uint64_t num_anomalous_frames_{};
+
+  std::uint64_t num_anomalies_{};
+
+  std::atomic<bool> closed_{};
+
+  bool finished_{};
+};
+
+}  // namespace
+
+auto SyntheticSource::Create(const pipeline::SyntheticSourceConfig& config, const PixelFormat format)
+    -> std::unique_ptr<SyntheticSource> {
+  return std::make_unique<SyntheticSourceImpl>(config, format);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <pipeline/synthetic_source_config.pb.h>
+
+#include <memory>
+
+#include "node.h"
+
+/**
+ * @brief Generates frames with synthetic anomalies at known positions, for benchmarks that need neither a camera nor
+ * data on disk.
+ *
+ * @details Anomalies are drawn onto a base image or a procedural texture. The ground truth of every frame, including
+ * frames without anomalies, can be written to a file so that throughput and detection recall are measured in the
+ * same run.
+ * */
+class SyntheticSource : public Node {
+ public:
+  /**
+   * @param format The format to generate frames in.
+   * */
+  static auto Create(const pipeline::SyntheticSourceConfig& config, PixelFormat format)
+      -> std::unique_ptr<SyntheticSource>;
+
+  ~SyntheticSource() override = default;
+};
@@ -0,0 +1,157 @@
+#include "tee.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t default_max_buffered{32};
+
+class TeeImpl final : public Tee, public std::enable_shared_from_this<TeeImpl> {
+ public:
+  TeeImpl(std::unique_ptr<Node> child, const pipeline::TeeConfig& config)
+      : child_(std::move(child)),
+        max_buffered_((config.max_buffered() > 0) ? config.max_buffered() : default_max_buffered) {}
+
+  [[nodiscard]] auto CreateBranch() -> std::unique_ptr<Node> override;
+
+  /**
+   * @note The child is only prepared once, no matter how many branches there are.
+   * */
+  [[nodiscard]] auto Prepare() -> bool {
+    if (!prepared_) {
+      prepared_ = child_->Prepare();
+    }
+    return *prepared_;
+  }
+
+  void Close() { child_->Close(); }
+
+  /**
+   * @note The child is only planned once, no matter how many branches there are.
+   * */
+  [[nodiscard]] auto Plan(const std::array<std::uint32_t, 2>& frame_size) -> OutputPlan {
+    if (!plan_) {
+      plan_ = child_->Plan(frame_size);
+    }
+    return *plan_;
+  }
+
+  /**
+   * @brief Gets the next output of a branch, pulling it from the child if no other branch has yet.
+   * */
+  [[nodiscard]] auto Step(const std::size_t branch) -> NodeOutput {
+    auto& position = positions_[branch];
+
+    if (static_cast<std::size_t>(position - base_) >= buffer_.size()) {
+      if (end_of_stream_) {
+        return NodeOutput();
+      }
+      if (buffer_.size() >= max_buffered_) {
+        DropOldest();
+      }
+      buffer_.emplace_back(child_->Step());
+      end_of_stream_ = buffer_.back().EndOfStream();
+    }
+
+    auto output = buffer_[static_cast<std::size_t>(position - base_)];
+
+    position++;
+
+    // Note: Outputs are dropped once the slowest branch has taken them.
+    const auto slowest = *std::min_element(positions_.begin(), positions_.end());
+    while (!buffer_.empty() && (base_ < slowest)) {
+      buffer_.pop_front();
+      base_++;
+    }
+
+    return output;
+  }
+
+ protected:
+  /**
+   * @brief Drops the oldest output, moving the branches that have not taken it yet past it.
+   * */
+  void DropOldest() {
+    buffer_.pop_front();
+    base_++;
+    for (std::size_t i = 0; i < positions_.size(); i++) {
+      if (positions_[i] >= base_) {
+        continue;
+      }
+      positions_[i] = base_;
+      if (num_dropped_[i]++ == 0) {
+        SPDLOG_WARN("Branch {} of a tee is more than {} outputs behind, dropping its oldest outputs.", i,
+                    max_buffered_);
+      }
+    }
+  }
+
+ private:
+  std::unique_ptr<Node> child_;
+
+  std::size_t max_buffered_{};
+
+  /**
+   * @brief The outputs that have been pulled from the child but not yet taken by every branch.
+   * */
+  std::deque<NodeOutput> buffer_;
+
+  /**
+   * @brief The position of the first output in the buffer.
+   * */
+  std::uint64_t base_{};
+
+  /**
+   * @brief The position of the next output of each branch.
+   * */
+  std::vector<std::uint64_t> positions_;
+
+  /**
+   * @brief The number of outputs that each branch missed because it lagged too far behind.
+   * */
+  std::vector<std::uint64_t> num_dropped_;
+
+  bool end_of_stream_{};
+
+  std::optional<bool> prepared_;
+
+  std::optional<OutputPlan> plan_;
+};
+
+class TeeBranch final : public Node {
+ public:
+  TeeBranch(std::shared_ptr<TeeImpl> tee, const std::size_t index) : tee_(std::move(tee)), index_(index) {}
+
+  [[nodiscard]] auto Step() -> NodeOutput override { return tee_->Step(index_); }
+
+  [[nodiscard]] auto Prepare() -> bool override { return tee_->Prepare(); }
+
+  void Close() override { tee_->Close(); }
+
+  [[nodiscard]] auto Plan(const std::array<std::uint32_t, 2>& frame_size) -> OutputPlan override {
+    return tee_->Plan(frame_size);
+  }
+
+ private:
+  std::shared_ptr<TeeImpl> tee_;
+
+  std::size_t index_{};
+};
+
+auto TeeImpl::CreateBranch() -> std::unique_ptr<Node> {
+  positions_.emplace_back(base_);
+  num_dropped_.emplace_back(0);
+  return std::make_unique<TeeBranch>(shared_from_this(), positions_.size() - 1);
+}
+
+}  // namespace
+
+auto Tee::Create(std::unique_ptr<Node> child, const pipeline::TeeConfig& config) -> std::shared_ptr<Tee> {
+  return std::make_shared<TeeImpl>(std::move(child), config);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <pipeline/tee_config.pb.h>
+
+#include <memory>
+
+#include "node.h"
+
+/**
+ * @brief Shares the outputs of a node between several branches.
+ *
+ * @details Each branch is a node that yields every output of the child, in order. An output is pulled from the child
+ * once, by whichever branch reaches it first, and is kept until every branch has taken it or the buffer is full.
+ * Branches share the same image by reference count, so no pixel data is copied.
+ * */
+class Tee {
+ public:
+  static auto Create(std::unique_ptr<Node> child, const pipeline::TeeConfig& config) -> std::shared_ptr<Tee>;
+
+  virtual ~Tee() = default;
+
+  /**
+   * @brief Creates a node that yields the outputs of the child.
+   *
+   * @note All branches must be created before the first branch is stepped.
+   * */
+  [[nodiscard]] virtual auto CreateBranch() -> std::unique_ptr<Node> = 0;
+};
@@ -0,0 +1,28 @@
+#include "tensor.h"
+
+#include <atomic>
+
+#include "image.h"
+
+namespace {
+
+std::atomic<std::uint64_t> num_allocations{0};
+
+}  // namespace
+
+Tensor::Tensor(const uint32_t channels, const uint32_t h, const uint32_t w) noexcept {
+  const auto size = static_cast<std::size_t>(channels) * h * w * sizeof(float);
+  if (size == 0) {
+    return;
+  }
+  const auto aligned_size = ((size + Image::alignment - 1) / Image::alignment) * Image::alignment;
+  data_.reset(static_cast<float*>(std::aligned_alloc(Image::alignment, aligned_size)));
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (data_) {
+    channels_ = channels;
+    height_ = h;
+    width_ = w;
+  }
+}
+
+auto Tensor::NumAllocations() -> std::uint64_t { return num_allocations.load(std::memory_order_relaxed); }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+
+/**
+ * @brief A planar floating point tensor, laid out as channels, rows and columns.
+ *
+ * @details This is the layout that the network takes as input, so a tensor can be given to the network without
+ * being converted first. The start of the data is aligned to @ref Image::alignment bytes.
+ * */
+class Tensor final {
+ public:
+  Tensor() noexcept = default;
+
+  /**
+   * @brief Allocates an uninitialized tensor.
+   *
+   * @note If the allocation fails, the tensor is empty.
+   * */
+  Tensor(uint32_t channels, uint32_t h, uint32_t w) noexcept;
+
+  /**
+   * @brief The number of tensors that have been allocated since the program started.
+   * */
+  [[nodiscard]] static auto NumAllocations() -> std::uint64_t;
+
+  [[nodiscard]] auto Data() -> float* { return data_.get(); }
+
+  [[nodiscard]] auto Data() const -> const float* { return data_.get(); }
+
+  /**
+   * @brief Gets the first element of a channel.
+   * */
+  [[nodiscard]] auto Plane(const uint32_t c) -> float* { return data_.get() + c * PlaneSize(); }
+
+  [[nodiscard]] auto Plane(const uint32_t c) const -> const float* { return data_.get() + c * PlaneSize(); }
+
+  [[nodiscard]] auto Channels() const -> uint32_t { return channels_; }
+
+  [[nodiscard]] auto Height() const -> uint32_t { return height_; }
+
+  [[nodiscard]] auto Width() const -> uint32_t { return width_; }
+
+  /**
+   * @brief The number of elements in each channel.
+   * */
+  [[nodiscard]] auto PlaneSize() const -> std::size_t { return static_cast<std::size_t>(width_) * height_; }
+
+  /**
+   * @brief The number of elements in the tensor.
+   * */
+  [[nodiscard]] auto Size() const -> std::size_t { return PlaneSize() * channels_; }
+
+  [[nodiscard]] auto Empty() const -> bool { return Size() == 0; }
+
+ private:
+  struct Deleter final {
+    void operator()(float* ptr) const { std::free(ptr); }
+  };
+
+  uint32_t channels_{};
+
+  uint32_t height_{};
+
+  uint32_t width_{};
+
+  std::unique_ptr<float, Deleter> data_;
+};
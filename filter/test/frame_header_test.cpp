@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include "frame_header.h"
+
+namespace {
+
+[[nodiscard]] auto Serialize(const FrameHeader& header, const std::size_t payload_size = 0) -> std::vector<char> {
+  std::vector<char> message(sizeof(FrameHeader) + payload_size, 'x');
+  std::memcpy(message.data(), &header, sizeof(FrameHeader));
+  return message;
+}
+
+}  // namespace
+
+TEST(FrameHeaderTest, ParsesHeaderInFrontOfFrame) {
+  FrameHeader header;
+  header.sequence = 42;
+  header.capture_time_us = 1'700'000'000'000'000;
+
+  const auto message = Serialize(header, 16);
+
+  const auto parsed = FrameHeader::Parse(message.data(), message.size());
+
+  ASSERT_TRUE(parsed.has_value());
+  EXPECT_EQ(parsed->sequence, 42);
+  EXPECT_EQ(parsed->capture_time_us, 1'700'000'000'000'000);
+}
+
+TEST(FrameHeaderTest, ParsesHeaderWithoutFrame) {
+  const auto message = Serialize(FrameHeader{});
+
+  EXPECT_TRUE(FrameHeader::Parse(message.data(), message.size()).has_value());
+}
+
+TEST(FrameHeaderTest, RejectsTruncatedMessage) {
+  const auto message = Serialize(FrameHeader{});
+
+  EXPECT_FALSE(FrameHeader::Parse(message.data(), message.size() - 1).has_value());
+  EXPECT_FALSE(FrameHeader::Parse(nullptr, 0).has_value());
+}
+
+TEST(FrameHeaderTest, RejectsBareEncodedFrame) {
+  // Note: The first bytes of a PNG file, as sent by sensors that predate the header.
+  std::vector<char> message{'\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n'};
+  message.resize(64);
+
+  EXPECT_FALSE(FrameHeader::Parse(message.data(), message.size()).has_value());
+}
+
+TEST(FrameHeaderTest, RejectsOtherVersion) {
+  FrameHeader header;
+  header.version = FrameHeader::current_version + 1;
+
+  const auto message = Serialize(header);
+
+  EXPECT_FALSE(FrameHeader::Parse(message.data(), message.size()).has_value());
+}
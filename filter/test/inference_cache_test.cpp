@@ -0,0 +1,154 @@
+#include "inference_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+class InferenceCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    const auto* info = ::testing::UnitTest::GetInstance()->current_test_info();
+    path_ = std::filesystem::temp_directory_path() / (std::string("ad_inference_cache_") + info->name());
+    std::filesystem::remove_all(path_);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(path_); }
+
+  [[nodiscard]] auto DiskConfig() const -> pipeline::InferenceCacheConfig {
+    pipeline::InferenceCacheConfig config;
+    config.set_path(path_.string());
+    return config;
+  }
+
+  [[nodiscard]] static auto MemoryConfig(const std::uint32_t capacity) -> pipeline::InferenceCacheConfig {
+    pipeline::InferenceCacheConfig config;
+    config.set_memory_capacity(capacity);
+    return config;
+  }
+
+  [[nodiscard]] static auto MakeKey(const std::uint64_t content_hash) -> InferenceKey {
+    return InferenceKey{1, content_hash, {8, 8, 16, 16}};
+  }
+
+  [[nodiscard]] static auto MakePrediction(const float value) -> cv::Mat {
+    return cv::Mat(4, 6, CV_32FC3, cv::Scalar(value, value + 1, value + 2));
+  }
+
+  [[nodiscard]] static auto Equal(const cv::Mat& a, const cv::Mat& b) -> bool {
+    return (a.rows == b.rows) && (a.cols == b.cols) && (a.type() == b.type()) &&
+           (std::memcmp(a.data, b.data, a.total() * a.elemSize()) == 0);
+  }
+
+  std::filesystem::path path_;
+};
+
+}  // namespace
+
+TEST_F(InferenceCacheTest, ImageHashIgnoresRowPadding) {
+  constexpr std::uint32_t w{5};
+  constexpr std::uint32_t h{3};
+
+  Image packed(w, h, PixelFormat::kGray8);
+  std::vector<std::uint8_t> padded_data(h * 8, 0xff);
+  Image padded(w, h, PixelFormat::kGray8, 1, 8, padded_data.data(), nullptr);
+
+  for (std::uint32_t y = 0; y < h; y++) {
+    for (std::uint32_t x = 0; x < w; x++) {
+      packed.Row(y)[x] = static_cast<std::uint8_t>(y * w + x);
+      padded.Row(y)[x] = static_cast<std::uint8_t>(y * w + x);
+    }
+  }
+
+  EXPECT_EQ(InferenceCache::Hash(packed), InferenceCache::Hash(padded));
+
+  padded.Row(h - 1)[w - 1]++;
+
+  EXPECT_NE(InferenceCache::Hash(packed), InferenceCache::Hash(padded));
+}
+
+TEST_F(InferenceCacheTest, ImageHashIncludesShape) {
+  std::vector<std::uint8_t> data(12, 7);
+  const Image wide(6, 2, PixelFormat::kGray8, 1, 6, data.data(), nullptr);
+  const Image tall(2, 6, PixelFormat::kGray8, 1, 2, data.data(), nullptr);
+  const Image color(2, 2, PixelFormat::kRgb8, 3, 6, data.data(), nullptr);
+  const Image bgr(2, 2, PixelFormat::kBgr8, 3, 6, data.data(), nullptr);
+
+  EXPECT_NE(InferenceCache::Hash(wide), InferenceCache::Hash(tall));
+  EXPECT_NE(InferenceCache::Hash(color), InferenceCache::Hash(bgr));
+}
+
+TEST_F(InferenceCacheTest, KeyIncludesInfill) {
+  InferenceCache cache(MemoryConfig(4), 1);
+
+  const auto key = MakeKey(2);
+  cache.Insert(key, MakePrediction(1));
+
+  auto other_infill = key;
+  other_infill.infill[0]++;
+
+  EXPECT_FALSE(cache.Find(key).empty());
+  EXPECT_TRUE(cache.Find(other_infill).empty());
+}
+
+TEST_F(InferenceCacheTest, EvictsLeastRecentlyUsedPrediction) {
+  InferenceCache cache(MemoryConfig(2), 1);
+
+  cache.Insert(MakeKey(1), MakePrediction(1));
+  cache.Insert(MakeKey(2), MakePrediction(2));
+  static_cast<void>(cache.Find(MakeKey(1)));
+  cache.Insert(MakeKey(3), MakePrediction(3));
+
+  EXPECT_FALSE(cache.Find(MakeKey(1)).empty());
+  EXPECT_TRUE(cache.Find(MakeKey(2)).empty());
+  EXPECT_FALSE(cache.Find(MakeKey(3)).empty());
+}
+
+TEST_F(InferenceCacheTest, LoadsPredictionStoredOnDisk) {
+  const auto prediction = MakePrediction(0.5F);
+
+  {
+    InferenceCache cache(DiskConfig(), 1);
+    cache.Insert(MakeKey(2), prediction);
+  }
+
+  InferenceCache cache(DiskConfig(), 1);
+
+  const auto loaded = cache.Find(MakeKey(2));
+
+  ASSERT_FALSE(loaded.empty());
+  EXPECT_TRUE(Equal(loaded, prediction));
+  EXPECT_TRUE(cache.Find(MakeKey(3)).empty());
+}
+
+TEST_F(InferenceCacheTest, DropsPredictionsOfPreviousModel) {
+  InferenceCache cache(DiskConfig(), 1);
+  cache.Insert(MakeKey(2), MakePrediction(1));
+
+  cache.SetModel(2);
+
+  auto key = MakeKey(2);
+  key.model_hash = 2;
+
+  EXPECT_TRUE(cache.Find(key).empty());
+  EXPECT_EQ(std::distance(std::filesystem::directory_iterator(path_), std::filesystem::directory_iterator()), 1);
+}
+
+TEST_F(InferenceCacheTest, KeepsDirectoryItDidNotCreate) {
+  {
+    InferenceCache cache(DiskConfig(), 1);
+    cache.Insert(MakeKey(2), MakePrediction(1));
+  }
+
+  InferenceCache cache(DiskConfig(), 1);
+  cache.SetModel(2);
+
+  InferenceCache previous(DiskConfig(), 1);
+
+  EXPECT_FALSE(previous.Find(MakeKey(2)).empty());
+}
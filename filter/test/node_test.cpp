@@ -0,0 +1,98 @@
+#include "node.h"
+
+#include <google/protobuf/util/json_util.h>
+#include <gtest/gtest.h>
+#include <pipeline/config.pb.h>
+
+#include <string>
+
+#include "exception.h"
+
+namespace {
+
+[[nodiscard]] auto ParseConfig(const std::string& json) -> pipeline::Config {
+  pipeline::Config config;
+  const auto status = google::protobuf::util::JsonStringToMessage(json, &config);
+  EXPECT_TRUE(status.ok()) << status.message();
+  return config;
+}
+
+/**
+ * @brief Builds a pipeline and returns the message of the exception that building it threw.
+ * */
+[[nodiscard]] auto BuildError(const std::string& json) -> std::string {
+  try {
+    static_cast<void>(Node::CreatePipeline(nullptr, ParseConfig(json)));
+  } catch (const Exception& e) {
+    return e.what();
+  }
+  return "";
+}
+
+}  // namespace
+
+TEST(GraphBuilderTest, ConsumesPreviousNodeByDefault) {
+  const auto config = ParseConfig(R"({
+    "frame_width": 64,
+    "frame_height": 64,
+    "pipeline": [
+      {"synthetic_source": {"width": 64, "height": 64, "num_frames": 1}},
+      {"tile_filter": {"width": 32, "height": 32, "stride_x": 32, "stride_y": 32}}
+    ]
+  })");
+
+  const auto root = Node::CreatePipeline(nullptr, config);
+
+  EXPECT_NO_THROW(Node::PreparePipeline(*root, config));
+}
+
+TEST(GraphBuilderTest, SharesNodeThroughTee) {
+  const auto config = ParseConfig(R"({
+    "frame_width": 64,
+    "frame_height": 64,
+    "pipeline": [
+      {"name": "camera", "synthetic_source": {"width": 64, "height": 64, "num_frames": 1}},
+      {"name": "split", "input": "camera", "tee": {}},
+      {"input": "split", "tile_filter": {"width": 32, "height": 32, "stride_x": 32, "stride_y": 32}},
+      {"input": "split", "tile_filter": {"width": 16, "height": 16, "stride_x": 16, "stride_y": 16}}
+    ]
+  })");
+
+  const auto root = Node::CreatePipeline(nullptr, config);
+
+  EXPECT_NO_THROW(Node::PreparePipeline(*root, config));
+}
+
+TEST(GraphBuilderTest, RejectsDuplicateName) {
+  const auto error = BuildError(R"({
+    "pipeline": [
+      {"name": "camera", "synthetic_source": {"width": 64, "height": 64}},
+      {"name": "camera", "synthetic_source": {"width": 64, "height": 64}}
+    ]
+  })");
+
+  EXPECT_NE(error.find("node name 'camera' is used more than once"), std::string::npos) << error;
+}
+
+TEST(GraphBuilderTest, RejectsUnknownInput) {
+  const auto error = BuildError(R"({
+    "pipeline": [
+      {"name": "camera", "synthetic_source": {"width": 64, "height": 64}},
+      {"input": "kamera", "tile_filter": {"width": 32, "height": 32, "stride_x": 32, "stride_y": 32}}
+    ]
+  })");
+
+  EXPECT_NE(error.find("unknown input node 'kamera'"), std::string::npos) << error;
+}
+
+TEST(GraphBuilderTest, RejectsSharedInputWithoutTee) {
+  const auto error = BuildError(R"({
+    "pipeline": [
+      {"name": "camera", "synthetic_source": {"width": 64, "height": 64}},
+      {"input": "camera", "tile_filter": {"width": 32, "height": 32, "stride_x": 32, "stride_y": 32}},
+      {"input": "camera", "tile_filter": {"width": 16, "height": 16, "stride_x": 16, "stride_y": 16}}
+    ]
+  })");
+
+  EXPECT_NE(error.find("node 'camera' is the input of more than one node"), std::string::npos) << error;
+}
@@ -0,0 +1,142 @@
+#include "tile_filter.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "exception.h"
+#include "image.h"
+
+namespace {
+
+constexpr std::uint32_t frame_size{64};
+
+/**
+ * @brief A source that produces one frame, whose pixels hold their own coordinates.
+ * */
+class FrameNode final : public Node {
+ public:
+  [[nodiscard]] auto Step() -> NodeOutput override {
+    if (done_) {
+      return NodeOutput();
+    }
+    done_ = true;
+
+    auto frame = std::make_shared<Image>(frame_size, frame_size, PixelFormat::kGray8);
+    for (std::uint32_t y = 0; y < frame_size; y++) {
+      for (std::uint32_t x = 0; x < frame_size; x++) {
+        frame->Row(y)[x] = static_cast<std::uint8_t>(((y / 32) * 2) + (x / 32));
+      }
+    }
+    return NodeOutput(std::move(frame), 0);
+  }
+
+  [[nodiscard]] auto Plan(const std::array<std::uint32_t, 2>& size) -> OutputPlan override {
+    OutputPlan plan;
+    plan.shape = ImageShape{size[0], size[1], 1, PixelFormat::kGray8};
+    return plan;
+  }
+
+ private:
+  bool done_{};
+};
+
+[[nodiscard]] auto MakeConfig() -> pipeline::TileFilterConfig {
+  pipeline::TileFilterConfig config;
+  config.set_width(32);
+  config.set_height(32);
+  config.set_stride_x(32);
+  config.set_stride_y(32);
+  return config;
+}
+
+void AddRect(pipeline::TileFilterConfig& config, std::uint32_t x, std::uint32_t y, std::uint32_t w, std::uint32_t h) {
+  auto* rect = config.mutable_roi()->add_rects();
+  rect->set_x(x);
+  rect->set_y(y);
+  rect->set_width(w);
+  rect->set_height(h);
+}
+
+/**
+ * @brief Plans a tile filter for one frame and returns the offsets of the tiles that it cuts from the frame.
+ * */
+[[nodiscard]] auto CutTiles(const pipeline::TileFilterConfig& config, std::size_t& outputs_per_frame)
+    -> std::vector<std::array<std::uint32_t, 2>> {
+  auto filter = TileFilter::Create(std::make_unique<FrameNode>(), config);
+
+  outputs_per_frame = filter->Plan({frame_size, frame_size}).outputs_per_frame;
+
+  std::vector<std::array<std::uint32_t, 2>> offsets;
+  for (auto output = filter->Step(); !output.EndOfStream(); output = filter->Step()) {
+    // Note: Each quadrant of the frame has its own value, so the tile shows which quadrant it was cut from.
+    EXPECT_EQ(output.image->Row(0)[0], ((output.offset[1] / 32) * 2) + (output.offset[0] / 32));
+    offsets.emplace_back(output.offset);
+  }
+  return offsets;
+}
+
+using Offsets = std::vector<std::array<std::uint32_t, 2>>;
+
+}  // namespace
+
+TEST(TileFilterTest, CutsWholeFrameWithoutRoi) {
+  std::size_t outputs_per_frame{};
+
+  const auto offsets = CutTiles(MakeConfig(), outputs_per_frame);
+
+  EXPECT_EQ(outputs_per_frame, 4);
+  EXPECT_EQ(offsets, (Offsets{{0, 0}, {32, 0}, {0, 32}, {32, 32}}));
+}
+
+TEST(TileFilterTest, SkipsTilesOutsideRoiRect) {
+  auto config = MakeConfig();
+  AddRect(config, 40, 40, 8, 8);
+
+  std::size_t outputs_per_frame{};
+
+  const auto offsets = CutTiles(config, outputs_per_frame);
+
+  EXPECT_EQ(outputs_per_frame, 1);
+  EXPECT_EQ(offsets, (Offsets{{32, 32}}));
+}
+
+TEST(TileFilterTest, KeepsTilesThatRoiRectStraddles) {
+  auto config = MakeConfig();
+  AddRect(config, 30, 0, 4, 4);
+
+  std::size_t outputs_per_frame{};
+
+  const auto offsets = CutTiles(config, outputs_per_frame);
+
+  EXPECT_EQ(outputs_per_frame, 2);
+  EXPECT_EQ(offsets, (Offsets{{0, 0}, {32, 0}}));
+}
+
+TEST(TileFilterTest, SkipsTilesOutsideRoiPolygon) {
+  auto config = MakeConfig();
+  auto* polygon = config.mutable_roi()->add_polygons();
+  for (const auto& [x, y] : std::vector<std::array<int, 2>>{{0, 40}, {20, 40}, {10, 60}}) {
+    auto* point = polygon->add_points();
+    point->set_x(x);
+    point->set_y(y);
+  }
+
+  std::size_t outputs_per_frame{};
+
+  const auto offsets = CutTiles(config, outputs_per_frame);
+
+  EXPECT_EQ(outputs_per_frame, 1);
+  EXPECT_EQ(offsets, (Offsets{{0, 32}}));
+}
+
+TEST(TileFilterTest, RejectsRoiOutsideFrame) {
+  auto config = MakeConfig();
+  AddRect(config, 100, 100, 8, 8);
+
+  auto filter = TileFilter::Create(std::make_unique<FrameNode>(), config);
+
+  EXPECT_THROW(static_cast<void>(filter->Plan({frame_size, frame_size})), Exception);
+}
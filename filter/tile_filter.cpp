@@ -3,122 +3,317 @@
 #include <spdlog/spdlog.h>
 
 #include <algorithm>
+#include <array>
+#include <cstring>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
 #include <optional>
+#include <vector>
+
+#include "buffer_pool.h"
+#include "exception.h"
+#include "image.h"
 
 namespace {
 
 struct TileState final {
   NodeOutput child_output;
+  std::size_t index{};
   std::uint32_t x{};
   std::uint32_t y{};
 };
 
 class TileFilterImpl final : public TileFilter {
  public:
-  TileFilterImpl(std::unique_ptr<Node> child, const pipeline::TileFilterConfig& config)
-      : child_(std::move(child)), config_(config) {}
+  TileFilterImpl(std::unique_ptr<Node> child, const pipeline::TileFilterConfig& config,
+                 std::shared_ptr<const LoadState> load_state)
+      : child_(std::move(child)), config_(config), load_state_(std::move(load_state)) {
+    const auto& roi = config_.roi();
+    if (!roi.mask_path().empty()) {
+      if (!roi_mask_.Load(roi.mask_path().c_str(), PixelFormat::kGray8)) {
+        throw Exception("Failed to load region of interest mask '" + roi.mask_path() + "'.");
+      }
+    }
+  }
 
   [[nodiscard]] auto Step() -> NodeOutput override {
-    if (!current_state_) {
+    while (!current_state_) {
       current_state_ = TileState{child_->Step()};
+
+      if (current_state_->child_output.EndOfStream()) {
+        break;
+      }
+
+      const auto& frame = *current_state_->child_output.image;
+
+      UpdateGrid(frame.Width(), frame.Height(), load_state_ ? load_state_->StrideScale() : 1);
+
+      if (grid_.empty()) {
+        SPDLOG_WARN("No tiles intersect the region of interest, skipping frame.");
+        current_state_.reset();
+      }
     }
 
     if (current_state_->child_output.EndOfStream()) {
       return current_state_->child_output;
     }
 
-    auto tile = std::make_shared<Image>(config_.width(), config_.height());
+    const auto& frame = *current_state_->child_output.image;
+
+    const ImageShape tile_shape{config_.width(), config_.height(), frame.Channels(), frame.Format()};
+
+    auto tile = tile_pool_->Acquire(tile_shape, tile_shape);
 
     if (tile->Empty() || current_state_->child_output.EndOfStream()) {
       return NodeOutput();
     }
 
+    current_state_->x = grid_[current_state_->index][0];
+    current_state_->y = grid_[current_state_->index][1];
+
     Blit(tile);
 
     auto output{NodeOutput(std::move(tile), current_state_->child_output.frame_id)};
     output.offset[0] = current_state_->child_output.offset[0] + current_state_->x;
     output.offset[1] = current_state_->child_output.offset[1] + current_state_->y;
     output.size = current_state_->child_output.size;
+    output.sequence = current_state_->child_output.sequence;
+    output.times = current_state_->child_output.times;
+    output.times.Mark(Stage::kTile);
 
-    auto valid_padding = config_.padding_mode() == pipeline::PaddingMode::VALID;
+    current_state_->index++;
 
-    auto row_complete{false};
+    if (current_state_->index >= grid_.size()) {
+      current_state_.reset();
+    }
 
-    if (valid_padding) {
-      const auto max_x{current_state_->x + config_.width()};
-      row_complete = (max_x + config_.stride_x()) > current_state_->child_output.image->Width();
-      const auto remaining{current_state_->child_output.image->Width() - max_x};
-      if (row_complete && (remaining > 0)) {
-        SPDLOG_WARN("Unable to tile last {} pixels in row.", remaining);
-      }
-    } else {
-      row_complete = (current_state_->x + config_.stride_x()) >= current_state_->child_output.image->Width();
+    return output;
+  }
+
+  [[nodiscard]] auto Prepare() -> bool override { return child_->Prepare(); }
+
+  void Close() override { child_->Close(); }
+
+  [[nodiscard]] auto Plan(const std::array<std::uint32_t, 2>& frame_size) -> OutputPlan override {
+    const auto input = child_->Plan(frame_size);
+
+    if ((config_.width() == 0) || (config_.height() == 0)) {
+      throw Exception("Tile size cannot be zero.");
     }
 
-    if (row_complete) {
-      current_state_->x = 0;
+    if ((config_.stride_x() == 0) || (config_.stride_y() == 0)) {
+      throw Exception("Tile stride cannot be zero.");
+    }
+
+    // Note: The plan is for the undegraded stride, which gives the most tiles per frame.
+    UpdateGrid(input.shape.width, input.shape.height, 1);
+
+    if (grid_.empty()) {
+      throw Exception("No tiles intersect the region of interest.");
+    }
+
+    OutputPlan plan;
+    plan.shape = ImageShape{config_.width(), config_.height(), input.shape.channels, input.shape.format};
+    plan.outputs_per_frame = input.outputs_per_frame * grid_.size();
+
+    // Note: A later node may keep the tiles of one frame, such as the change gate, while the next frame is cut.
+    tile_pool_->Reserve(plan.shape, plan.outputs_per_frame * 2, plan.shape);
+
+    return plan;
+  }
+
+ protected:
+  /**
+   * @brief Computes the positions of the tiles of a frame, if the frame size or the stride scale has changed.
+   *
+   * @details Tiles that do not intersect the region of interest are left out of the grid.
+   *
+   * @param stride_scale The factor to widen the configured stride by.
+   * */
+  void UpdateGrid(const std::uint32_t frame_w, const std::uint32_t frame_h, const std::uint32_t stride_scale) {
+    const std::array<std::uint32_t, 3> key{frame_w, frame_h, stride_scale};
+
+    if (grid_key_ == key) {
+      return;
+    }
+
+    grid_key_ = key;
+
+    grid_.clear();
+
+    const auto mask = CreateRoiMask(frame_w, frame_h);
+
+    const auto valid_padding = config_.padding_mode() == pipeline::PaddingMode::VALID;
+
+    const auto stride_x = config_.stride_x() * stride_scale;
+    const auto stride_y = config_.stride_y() * stride_scale;
+
+    std::size_t num_tiles{};
+
+    for (std::uint32_t y = 0;; y += stride_y) {
+      for (std::uint32_t x = 0;; x += stride_x) {
+        num_tiles++;
+
+        if (mask.empty() || IntersectsRoi(mask, x, y)) {
+          grid_.emplace_back(std::array<std::uint32_t, 2>{x, y});
+        }
+
+        auto row_complete{false};
+
+        if (valid_padding) {
+          const auto max_x{x + config_.width()};
+          row_complete = (max_x + stride_x) > frame_w;
+          const auto remaining{frame_w - max_x};
+          if (row_complete && (remaining > 0)) {
+            SPDLOG_WARN("Unable to tile last {} pixels in row.", remaining);
+          }
+        } else {
+          row_complete = (x + stride_x) >= frame_w;
+        }
+
+        if (row_complete) {
+          break;
+        }
+      }
 
       auto frame_complete{false};
 
       if (valid_padding) {
-        const auto max_y{current_state_->y + config_.height()};
-        frame_complete = (max_y + config_.stride_y()) > current_state_->child_output.image->Height();
-        const auto remaining = current_state_->child_output.image->Height() - max_y;
+        const auto max_y{y + config_.height()};
+        frame_complete = (max_y + stride_y) > frame_h;
+        const auto remaining = frame_h - max_y;
         if (frame_complete && (remaining > 0)) {
           SPDLOG_WARN("Unable to tile last {} pixel rows in frame.", remaining);
         }
       } else {
-        frame_complete = (current_state_->y + config_.stride_y()) >= current_state_->child_output.image->Height();
+        frame_complete = (y + stride_y) >= frame_h;
       }
 
       if (frame_complete) {
-        current_state_.reset();
+        break;
+      }
+    }
+
+    if (stride_scale > 1) {
+      SPDLOG_INFO("Tile stride widened {} times, {} tiles per frame.", stride_scale, grid_.size());
+    } else if (!mask.empty()) {
+      SPDLOG_INFO("{} of {} tiles intersect the region of interest.", grid_.size(), num_tiles);
+    }
+  }
+
+  /**
+   * @brief Rasterizes the region of interest at the size of the frame.
+   *
+   * @return The mask, which is non-zero inside the region, or an empty matrix if no region is configured.
+   * */
+  [[nodiscard]] auto CreateRoiMask(const std::uint32_t frame_w, const std::uint32_t frame_h) const -> cv::Mat {
+    const auto& roi = config_.roi();
+
+    if (roi_mask_.Empty() && (roi.rects_size() == 0) && (roi.polygons_size() == 0)) {
+      return cv::Mat();
+    }
+
+    const auto w = static_cast<int>(frame_w);
+    const auto h = static_cast<int>(frame_h);
+
+    cv::Mat mask(h, w, CV_8UC1, cv::Scalar(0));
+
+    if (!roi_mask_.Empty()) {
+      const cv::Mat source(static_cast<int>(roi_mask_.Height()), static_cast<int>(roi_mask_.Width()), CV_8UC1,
+                           const_cast<std::uint8_t*>(roi_mask_.Data()), roi_mask_.Stride());
+      if ((source.cols == w) && (source.rows == h)) {
+        source.copyTo(mask);
       } else {
-        current_state_->y += config_.stride_y();
+        cv::resize(source, mask, cv::Size(w, h), 0, 0, cv::INTER_NEAREST);
       }
-    } else {
-      current_state_->x += config_.stride_x();
     }
 
-    return output;
+    for (const auto& rect : roi.rects()) {
+      cv::rectangle(mask,
+                    cv::Rect(static_cast<int>(rect.x()), static_cast<int>(rect.y()), static_cast<int>(rect.width()),
+                             static_cast<int>(rect.height())),
+                    cv::Scalar(255), cv::FILLED);
+    }
+
+    std::vector<std::vector<cv::Point>> polygons;
+
+    for (const auto& polygon : roi.polygons()) {
+      auto& points = polygons.emplace_back();
+      for (const auto& point : polygon.points()) {
+        points.emplace_back(point.x(), point.y());
+      }
+    }
+
+    if (!polygons.empty()) {
+      cv::fillPoly(mask, polygons, cv::Scalar(255));
+    }
+
+    return mask;
+  }
+
+  [[nodiscard]] auto IntersectsRoi(const cv::Mat& mask, const std::uint32_t x, const std::uint32_t y) const -> bool {
+    const auto area = cv::Rect(static_cast<int>(x), static_cast<int>(y), static_cast<int>(config_.width()),
+                               static_cast<int>(config_.height())) &
+                      cv::Rect(0, 0, mask.cols, mask.rows);
+    if (area.empty()) {
+      return false;
+    }
+    return cv::countNonZero(mask(area)) > 0;
   }
 
- protected:
   void Blit(std::shared_ptr<Image>& tile) {
     const auto w = config_.width();
     const auto h = config_.height();
 
-    auto* dst = tile->Data();
-
-    const auto* src = current_state_->child_output.image->Data();
+    const auto& frame = *current_state_->child_output.image;
 
     const auto replicate{config_.padding_mode() == pipeline::PaddingMode::REPLICATE};
 
-    const auto frame_w = current_state_->child_output.image->Width();
-    const auto frame_h = current_state_->child_output.image->Height();
+    const auto frame_w = frame.Width();
+    const auto frame_h = frame.Height();
+
+    const auto pixel_size = frame.PixelSize();
 
-    const auto max_frame_x = replicate ? (frame_w - 1) : frame_w;
     const auto max_frame_y = replicate ? (frame_h - 1) : frame_h;
 
+    const auto tile_x = current_state_->x;
+
+    // Note: The tile is clamped to the frame once, so that the pixels inside the frame are copied with one call per
+    //       row, and only the padding past the right edge is filled pixel by pixel.
+    const std::uint32_t span_w = (tile_x < frame_w) ? std::min(w, frame_w - tile_x) : 0;
+
     for (std::uint32_t y = 0; y < h; y++) {
-      const auto src_y = std::clamp(current_state_->y + y, 0u, max_frame_y);
+      const auto src_y = std::min(current_state_->y + y, max_frame_y);
 
-      for (std::uint32_t x = 0; x < w; x++) {
-        std::array<uint8_t, 3> rgb{0, 0, 0};
+      auto* dst = tile->Row(y);
 
-        const auto src_x = std::clamp(current_state_->x + x, 0u, max_frame_x);
+      if (src_y >= frame_h) {
+        std::memset(dst, 0, static_cast<std::size_t>(w) * pixel_size);
+        continue;
+      }
 
-        if ((src_x < frame_w) && (src_y < frame_h)) {
-          const auto src_i = src_y * current_state_->child_output.image->Width() + src_x;
-          rgb[0] = src[src_i * 3 + 0];
-          rgb[1] = src[src_i * 3 + 1];
-          rgb[2] = src[src_i * 3 + 2];
-        }
+      const auto* src = frame.Row(src_y);
+
+      if (span_w > 0) {
+        std::memcpy(dst, src + static_cast<std::size_t>(tile_x) * pixel_size,
+                    static_cast<std::size_t>(span_w) * pixel_size);
+      }
+
+      if (span_w == w) {
+        continue;
+      }
+
+      auto* padding = dst + static_cast<std::size_t>(span_w) * pixel_size;
+      const auto padding_size = static_cast<std::size_t>(w - span_w) * pixel_size;
+
+      if (!replicate) {
+        std::memset(padding, 0, padding_size);
+        continue;
+      }
 
-        const auto dst_i = y * w + x;
-        dst[dst_i * 3 + 0] = rgb[0];
-        dst[dst_i * 3 + 1] = rgb[1];
-        dst[dst_i * 3 + 2] = rgb[2];
+      const auto* edge = src + static_cast<std::size_t>(frame_w - 1) * pixel_size;
+      for (std::size_t offset = 0; offset < padding_size; offset += pixel_size) {
+        std::memcpy(padding + offset, edge, pixel_size);
       }
     }
   }
@@ -129,11 +324,27 @@ class TileFilterImpl final : public TileFilter {
   std::unique_ptr<Node> child_;
 
   pipeline::TileFilterConfig config_;
+
+  Image roi_mask_;
+
+  std::shared_ptr<ImagePool> tile_pool_{ImagePool::Create()};
+
+  /**
+   * @brief The positions of the tiles to emit for each frame.
+   * */
+  std::vector<std::array<std::uint32_t, 2>> grid_;
+
+  /**
+   * @brief The frame size and stride scale that the grid was computed for.
+   * */
+  std::optional<std::array<std::uint32_t, 3>> grid_key_;
+
+  std::shared_ptr<const LoadState> load_state_;
 };
 
 }  // namespace
 
-auto TileFilter::Create(std::unique_ptr<Node> child,
-                        const pipeline::TileFilterConfig& config) -> std::unique_ptr<TileFilter> {
-  return std::make_unique<TileFilterImpl>(std::move(child), config);
+auto TileFilter::Create(std::unique_ptr<Node> child, const pipeline::TileFilterConfig& config,
+                        std::shared_ptr<const LoadState> load_state) -> std::unique_ptr<TileFilter> {
+  return std::make_unique<TileFilterImpl>(std::move(child), config, std::move(load_state));
 }
@@ -2,12 +2,17 @@
 
 #include <pipeline/tile_filter_config.pb.h>
 
+#include "load_shedder.h"
 #include "node.h"
 
 class TileFilter : public Node {
  public:
+  /**
+   * @param load_state If given, the stride is widened by its stride scale while the pipeline is degraded.
+   * */
   static auto Create(std::unique_ptr<Node> child,
-                     const pipeline::TileFilterConfig& cfg)
+                     const pipeline::TileFilterConfig& cfg,
+                     std::shared_ptr<const LoadState> load_state = nullptr)
       -> std::unique_ptr<TileFilter>;
 
   ~TileFilter() override = default;
@@ -4,39 +4,111 @@
 #include <zmq.h>
 
 #include <cerrno>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
 #include <vector>
 
+#include "decode_arena.h"
 #include "deps/stb_image_write.h"
+#include "latency_tracker.h"
 
 namespace {
 
-class ZmqSinkImpl final : public ZmqSink {
+/**
+ * @brief A publisher socket that is shared by all sinks bound to the same address.
+ *
+ * @details When the pipeline is reloaded, the new pipeline is built while the old one is still bound to the address,
+ * so the socket stays open for as long as any sink uses it.
+ * */
+class PublisherSocket final {
  public:
-  ZmqSinkImpl(std::unique_ptr<Node> child_node, void* zmq_context, const pipeline::ZmqSinkConfig& config)
-      : child_node_(std::move(child_node)), config_(config), socket_(zmq_socket(zmq_context, ZMQ_PUB)) {
-    if (zmq_bind(socket_, config.bind_address().c_str()) != 0) {
+  PublisherSocket(void* zmq_context, const std::string& address) : socket_(zmq_socket(zmq_context, ZMQ_PUB)) {
+    int conflate{1};  // TODO : make it configurable
+    zmq_setsockopt(socket_, ZMQ_CONFLATE, &conflate, sizeof(conflate));
+    if (zmq_bind(socket_, address.c_str()) != 0) {
       const auto err = errno;
-      SPDLOG_ERROR("Failed to bind to '{}': {}", config.bind_address(), std::strerror(err));
+      SPDLOG_ERROR("Failed to bind to '{}': {}", address, std::strerror(err));
     }
-    int conflate{1};  // TODO : make it configurable
-    zmq_setsockopt(&socket_, ZMQ_CONFLATE, &conflate, sizeof(conflate));
-    SPDLOG_INFO("ZMQ sink publishing to '{}'.", config.bind_address());
   }
 
-  ~ZmqSinkImpl()
-  {
-    zmq_close(socket_);
+  PublisherSocket(const PublisherSocket&) = delete;
+
+  auto operator=(const PublisherSocket&) -> PublisherSocket& = delete;
+
+  ~PublisherSocket() { zmq_close(socket_); }
+
+  /**
+   * @brief Gets the socket bound to an address, binding a new one if no sink is using the address.
+   * */
+  [[nodiscard]] static auto Acquire(void* zmq_context, const std::string& address) -> std::shared_ptr<PublisherSocket> {
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<PublisherSocket>> sockets;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto& entry = sockets[address];
+    auto socket = entry.lock();
+    if (!socket) {
+      socket = std::make_shared<PublisherSocket>(zmq_context, address);
+      entry = socket;
+    }
+    return socket;
+  }
+
+  [[nodiscard]] auto Get() -> void* { return socket_; }
+
+ private:
+  void* socket_{};
+};
+
+class ZmqSinkImpl final : public ZmqSink {
+ public:
+  ZmqSinkImpl(std::unique_ptr<Node> child_node, void* zmq_context, const pipeline::ZmqSinkConfig& config)
+      : child_node_(std::move(child_node)),
+        config_(config),
+        socket_(PublisherSocket::Acquire(zmq_context, config.bind_address())),
+        latency_("ZMQ sink '" + config.bind_address() + "'",
+                 std::chrono::milliseconds(config.latency_report_interval_ms())) {
+    SPDLOG_INFO("ZMQ sink publishing to '{}'.", config.bind_address());
   }
 
   [[nodiscard]] auto Step() -> NodeOutput {
     auto child_output = child_node_->Step();
     if (child_output.EndOfStream()) {
+      latency_.Report();
       return NodeOutput();
     }
 
-    std::vector<std::uint8_t> buffer;
+    if (config_.anomalous_only() && !(child_output.scores && child_output.scores->anomalous)) {
+      return child_output;
+    }
+
+    Send(child_output);
+
+    child_output.times.Mark(Stage::kSink);
+
+    latency_.Record(child_output.times);
+
+    return child_output;
+  }
+
+  [[nodiscard]] auto Prepare() -> bool override { return child_node_->Prepare(); }
+
+  void Close() override { child_node_->Close(); }
+
+  [[nodiscard]] auto Plan(const std::array<std::uint32_t, 2>& frame_size) -> OutputPlan override {
+    return child_node_->Plan(frame_size);
+  }
+
+ protected:
+  void Send(const NodeOutput& child_output) {
+    // Note: The buffer keeps its capacity between frames, and the encoder works in the decode arena, so that encoding
+    //       does not allocate once both have grown to fit the largest frame.
+    png_.clear();
 
     auto write_to_buffer = [](void* buffer_ptr, void* data, const int len) {
       auto* ptr = static_cast<std::vector<std::uint8_t>*>(buffer_ptr);
@@ -47,22 +119,24 @@ class ZmqSinkImpl final : public ZmqSink {
 
     const auto& img = *child_output.image;
 
-    stbi_write_png_to_func(write_to_buffer, &buffer, img.Width(), img.Height(), 3, img.Data(), img.Width() * 3);
+    {
+      const DecodeArena::Scope scope;
+      stbi_write_png_to_func(write_to_buffer, &png_, img.Width(), img.Height(), img.Channels(), img.Data(),
+                             img.Stride());
+    }
 
     zmq_msg_t msg{};
 
-    zmq_msg_init_size(&msg, buffer.size());
+    zmq_msg_init_size(&msg, png_.size());
 
-    std::memcpy(zmq_msg_data(&msg), buffer.data(), buffer.size());  // TODO : use zero copy mechanism
+    std::memcpy(zmq_msg_data(&msg), png_.data(), png_.size());  // TODO : use zero copy mechanism
 
-    if (zmq_msg_send(&msg, socket_, 0) < 0) {
+    if (zmq_msg_send(&msg, socket_->Get(), 0) < 0) {
       const auto err = errno;
       SPDLOG_ERROR("Failed to send ZMQ message: {}", std::strerror(err));
     }
 
     zmq_msg_close(&msg);
-
-    return child_output;
   }
 
  private:
@@ -70,7 +144,14 @@ class ZmqSinkImpl final : public ZmqSink {
 
   pipeline::ZmqSinkConfig config_;
 
-  void* socket_{};
+  std::shared_ptr<PublisherSocket> socket_;
+
+  LatencyTracker latency_;
+
+  /**
+   * @brief The encoded frame that is being sent.
+   * */
+  std::vector<std::uint8_t> png_;
 };
 
 }  // namespace
@@ -3,56 +3,206 @@
 #include <spdlog/spdlog.h>
 #include <zmq.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <chrono>
+#include <cstdint>
 #include <cstring>
+#include <optional>
+#include <string>
+
+#include "buffer_pool.h"
+#include "frame_header.h"
+#include "recording.h"
 
 namespace {
 
+/**
+ * @brief How long a receive waits before checking whether the source was closed.
+ * */
+constexpr int receive_timeout_ms{100};
+
+/**
+ * @brief The number of frames that are reserved: the one being decoded, one queued by a load shedder, and the ones
+ * that downstream nodes still hold.
+ * */
+constexpr std::size_t reserved_frames{4};
+
 class ZmqSourceImpl final : public ZmqSource {
  public:
-  ZmqSourceImpl(void* zmq_context, const pipeline::ZmqSourceConfig& cfg) : socket_(zmq_socket(zmq_context, ZMQ_SUB)) {
+  ZmqSourceImpl(void* zmq_context, const pipeline::ZmqSourceConfig& cfg, const PixelFormat format)
+      : socket_(zmq_socket(zmq_context, ZMQ_SUB)), format_(format) {
+    if (!cfg.topic().empty()) {
+      prefix_ = cfg.topic();
+      prefix_.push_back('\0');
+    }
     if (zmq_connect(socket_, cfg.connect_address().c_str()) != 0) {
       SPDLOG_ERROR("Failed to connect to '{}': {}", cfg.connect_address().c_str(), std::strerror(errno));
       failed_ = true;
     }
-    zmq_setsockopt(socket_, ZMQ_SUBSCRIBE, "", 0);
+    zmq_setsockopt(socket_, ZMQ_SUBSCRIBE, prefix_.data(), prefix_.size());
     int conflate{1};
     zmq_setsockopt(socket_, ZMQ_CONFLATE, &conflate, 1);
+    int timeout{receive_timeout_ms};
+    zmq_setsockopt(socket_, ZMQ_RCVTIMEO, &timeout, sizeof(timeout));
+    int linger{0};
+    zmq_setsockopt(socket_, ZMQ_LINGER, &linger, sizeof(linger));
+    if (!cfg.record_path().empty()) {
+      recorder_.emplace(cfg.record_path());
+    }
   }
 
+  ZmqSourceImpl(const ZmqSourceImpl&) = delete;
+
+  ZmqSourceImpl(ZmqSourceImpl&&) = delete;
+
+  ~ZmqSourceImpl() override { zmq_close(socket_); }
+
+  auto operator=(const ZmqSourceImpl&) -> ZmqSourceImpl& = delete;
+
+  auto operator=(ZmqSourceImpl&&) -> ZmqSourceImpl& = delete;
+
   [[nodiscard]] auto Step() -> NodeOutput override {
     if (failed_) {
       return NodeOutput();
     }
 
-    auto img = std::make_shared<Image>();
-
     zmq_msg_t msg{};
     zmq_msg_init(&msg);
-    if (zmq_msg_recv(&msg, socket_, 0) > 0) {
-      if (!img->LoadFromMemory(zmq_msg_data(&msg), zmq_msg_size(&msg))) {
+
+    // Note: The receive times out regularly, so that closing the source from another thread ends a wait for a
+    //       message that may never come.
+    while (true) {
+      if (closed_) {
+        zmq_msg_close(&msg);
+        Finish();
+        return NodeOutput();
+      }
+      if (zmq_msg_recv(&msg, socket_, 0) >= 0) {
+        break;
+      }
+      if ((errno != EAGAIN) && (errno != EINTR)) {
+        SPDLOG_ERROR("Failed to receive from ZMQ subscriber: {}", std::strerror(errno));
+        zmq_msg_close(&msg);
+        Finish();
+        return NodeOutput();
+      }
+    }
+
+    std::shared_ptr<Image> img;
+
+    std::optional<FrameHeader> header;
+
+    if (zmq_msg_size(&msg) > 0) {
+      const auto* data = static_cast<const std::uint8_t*>(zmq_msg_data(&msg));
+      auto size = zmq_msg_size(&msg);
+      // Note: The subscription only lets messages that start with the prefix through.
+      data += prefix_.size();
+      size -= prefix_.size();
+      if (recorder_) {
+        recorder_->Write(data, size);
+      }
+      header = FrameHeader::Parse(data, size);
+      if (header) {
+        data += sizeof(FrameHeader);
+        size -= sizeof(FrameHeader);
+      }
+      img = DecodePooled(*frame_pool_, data, size, format_);
+      if (!img) {
         SPDLOG_ERROR("Failed to load image from ZMQ subscriber.");
+        zmq_msg_close(&msg);
         return NodeOutput();
       }
       SPDLOG_INFO("Received image from ZMQ subscriber.");
     }
     zmq_msg_close(&msg);
 
+    if (!img) {
+      img = std::make_shared<Image>();
+    }
+
     auto output = NodeOutput(std::move(img), frame_id_);
+    output.times.Mark(Stage::kReceive);
+    if (header) {
+      SetCaptureTime(output, *header);
+    }
     frame_id_++;
     return output;
   }
 
+  void Close() override { closed_ = true; }
+
+  [[nodiscard]] auto Plan(const std::array<std::uint32_t, 2>& frame_size) -> OutputPlan override {
+    const ImageShape shape{frame_size[0], frame_size[1], Image::FormatChannels(format_), format_};
+    frame_pool_->Reserve(shape, reserved_frames, shape);
+    return OutputPlan{shape, 1};
+  }
+
+ protected:
+  /**
+   * @brief Flushes the recording once the stream has ended.
+   * */
+  void Finish() {
+    if (finished_) {
+      return;
+    }
+    finished_ = true;
+    if (recorder_) {
+      recorder_->Flush();
+      SPDLOG_INFO("Recorded {} messages.", recorder_->NumMessages());
+    }
+  }
+
+  /**
+   * @brief Takes the sequence number and capture time of a frame from the header that the sensor sent with it.
+   *
+   * @details The capture time is converted to the steady clock by its age on the system clock, which assumes that
+   * the clocks of the sensor and this process are in sync.
+   * */
+  void SetCaptureTime(NodeOutput& output, const FrameHeader& header) {
+    if (last_sequence_ && (header.sequence > (*last_sequence_ + 1))) {
+      SPDLOG_DEBUG("Missed {} frames from the sensor.", header.sequence - *last_sequence_ - 1);
+    }
+    last_sequence_ = header.sequence;
+
+    output.sequence = header.sequence;
+
+    const std::chrono::system_clock::time_point capture_time{std::chrono::microseconds(header.capture_time_us)};
+    const auto age = std::max(std::chrono::system_clock::now() - capture_time, std::chrono::system_clock::duration{});
+    output.times.Set(Stage::kCapture,
+                     output.times.Get(Stage::kReceive) -
+                         std::chrono::duration_cast<StageTimes::Clock::duration>(age));
+  }
+
  private:
   void* socket_{};
 
+  /**
+   * @brief The topic and the zero byte that start each message, or empty if the sensor does not use topics.
+   * */
+  std::string prefix_;
+
   bool failed_{};
 
+  std::atomic<bool> closed_{};
+
+  bool finished_{};
+
   std::uint32_t frame_id_{};
+
+  std::optional<std::uint64_t> last_sequence_;
+
+  std::shared_ptr<ImagePool> frame_pool_{ImagePool::Create()};
+
+  std::optional<RecordingWriter> recorder_;
+
+  PixelFormat format_{PixelFormat::kRgb8};
 };
 
 }  // namespace
 
-auto ZmqSource::Create(void* zmq_context, const pipeline::ZmqSourceConfig& cfg) -> std::unique_ptr<ZmqSource> {
-  return std::make_unique<ZmqSourceImpl>(zmq_context, cfg);
+auto ZmqSource::Create(void* zmq_context, const pipeline::ZmqSourceConfig& cfg, const PixelFormat format)
+    -> std::unique_ptr<ZmqSource> {
+  return std::make_unique<ZmqSourceImpl>(zmq_context, cfg, format);
 }
@@ -6,7 +6,11 @@
 
 class ZmqSource : public Node {
  public:
-  static auto Create(void* zmq_context, const pipeline::ZmqSourceConfig& config) -> std::unique_ptr<ZmqSource>;
+  /**
+   * @param format The format to decode received images to.
+   * */
+  static auto Create(void* zmq_context, const pipeline::ZmqSourceConfig& config, PixelFormat format)
+      -> std::unique_ptr<ZmqSource>;
 
   ~ZmqSource() = default;
 };
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define AUGMENTATION_NEON 1
+#elif defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define AUGMENTATION_SSSE3 1
+#endif
+
+/**
+ * @brief Conversions between interleaved (HWC) pixels, as image files store them, and planar (CHW) pixels, as the
+ * networks take them.
+ *
+ * @details Three channel images use SIMD shuffles where the CPU has them, and a scalar loop otherwise. All other
+ * channel counts, and the pixels left over at the end of a row of vectors, use the scalar loop.
+ * */
+namespace interleave {
+
+namespace detail {
+
+inline void DeinterleaveScalar(const std::uint8_t* pixels, std::uint8_t* planes, const std::size_t begin,
+                               const std::size_t end, const std::size_t num_pixels, const int channels) {
+  for (std::size_t i = begin; i < end; i++) {
+    for (int c = 0; c < channels; c++) {
+      planes[c * num_pixels + i] = pixels[i * channels + c];
+    }
+  }
+}
+
+inline void InterleaveScalar(const std::uint8_t* planes, std::uint8_t* pixels, const std::size_t begin,
+                             const std::size_t end, const std::size_t num_pixels, const int channels) {
+  for (std::size_t i = begin; i < end; i++) {
+    for (int c = 0; c < channels; c++) {
+      pixels[i * channels + c] = planes[c * num_pixels + i];
+    }
+  }
+}
+
+#if defined(AUGMENTATION_SSSE3)
+
+using Mask = std::array<std::int8_t, 16>;
+
+/**
+ * @brief The byte shuffles that gather one channel of 16 RGB pixels from each of the three vectors they span. Entry
+ * (channel * 3 + vector) selects the bytes of that channel which lie in that vector, and zeroes the rest.
+ * */
+constexpr auto MakeDeinterleaveMasks() -> std::array<Mask, 9> {
+  std::array<Mask, 9> masks{};
+  for (int c = 0; c < 3; c++) {
+    for (int v = 0; v < 3; v++) {
+      for (int j = 0; j < 16; j++) {
+        const auto index = 3 * j + c - 16 * v;
+        masks[c * 3 + v][j] = static_cast<std::int8_t>(((index >= 0) && (index < 16)) ? index : -128);
+      }
+    }
+  }
+  return masks;
+}
+
+/**
+ * @brief The byte shuffles that scatter 16 pixels of one channel into each of the three vectors of RGB pixels. Entry
+ * (vector * 3 + channel) places the bytes of that channel which belong in that vector, and zeroes the rest.
+ * */
+constexpr auto MakeInterleaveMasks() -> std::array<Mask, 9> {
+  std::array<Mask, 9> masks{};
+  for (int v = 0; v < 3; v++) {
+    for (int c = 0; c < 3; c++) {
+      for (int j = 0; j < 16; j++) {
+        const auto index = 16 * v + j;
+        masks[v * 3 + c][j] = static_cast<std::int8_t>(((index % 3) == c) ? (index / 3) : -128);
+      }
+    }
+  }
+  return masks;
+}
+
+alignas(16) inline constexpr auto deinterleave_masks = MakeDeinterleaveMasks();
+
+alignas(16) inline constexpr auto interleave_masks = MakeInterleaveMasks();
+
+[[nodiscard]] inline auto LoadMask(const Mask& mask) -> __m128i {
+  return _mm_load_si128(reinterpret_cast<const __m128i*>(mask.data()));
+}
+
+/**
+ * @return The number of pixels that were converted, which is a multiple of 16.
+ * */
+__attribute__((target("ssse3"))) inline auto DeinterleaveRgb(const std::uint8_t* pixels, std::uint8_t* planes,
+                                                             const std::size_t num_pixels) -> std::size_t {
+  const auto count = num_pixels - (num_pixels % 16);
+  for (std::size_t i = 0; i < count; i += 16) {
+    const auto* src = reinterpret_cast<const __m128i*>(pixels + i * 3);
+    const auto a = _mm_loadu_si128(src);
+    const auto b = _mm_loadu_si128(src + 1);
+    const auto c = _mm_loadu_si128(src + 2);
+    for (int channel = 0; channel < 3; channel++) {
+      const auto* masks = &deinterleave_masks[channel * 3];
+      const auto plane = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, LoadMask(masks[0])),
+                                                   _mm_shuffle_epi8(b, LoadMask(masks[1]))),
+                                      _mm_shuffle_epi8(c, LoadMask(masks[2])));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(planes + channel * num_pixels + i), plane);
+    }
+  }
+  return count;
+}
+
+/**
+ * @return The number of pixels that were converted, which is a multiple of 16.
+ * */
+__attribute__((target("ssse3"))) inline auto InterleaveRgb(const std::uint8_t* planes, std::uint8_t* pixels,
+                                                           const std::size_t num_pixels) -> std::size_t {
+  const auto count = num_pixels - (num_pixels % 16);
+  for (std::size_t i = 0; i < count; i += 16) {
+    const auto r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + i));
+    const auto g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + num_pixels + i));
+    const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + 2 * num_pixels + i));
+    auto* dst = reinterpret_cast<__m128i*>(pixels + i * 3);
+    for (int v = 0; v < 3; v++) {
+      const auto* masks = &interleave_masks[v * 3];
+      const auto out = _mm_or_si128(
+          _mm_or_si128(_mm_shuffle_epi8(r, LoadMask(masks[0])), _mm_shuffle_epi8(g, LoadMask(masks[1]))),
+          _mm_shuffle_epi8(b, LoadMask(masks[2])));
+      _mm_storeu_si128(dst + v, out);
+    }
+  }
+  return count;
+}
+
+[[nodiscard]] inline auto HasSsse3() -> bool {
+  static const bool supported = __builtin_cpu_supports("ssse3");
+  return supported;
+}
+
+#elif defined(AUGMENTATION_NEON)
+
+inline auto DeinterleaveRgb(const std::uint8_t* pixels, std::uint8_t* planes, const std::size_t num_pixels)
+    -> std::size_t {
+  const auto count = num_pixels - (num_pixels % 16);
+  for (std::size_t i = 0; i < count; i += 16) {
+    const auto rgb = vld3q_u8(pixels + i * 3);
+    vst1q_u8(planes + i, rgb.val[0]);
+    vst1q_u8(planes + num_pixels + i, rgb.val[1]);
+    vst1q_u8(planes + 2 * num_pixels + i, rgb.val[2]);
+  }
+  return count;
+}
+
+inline auto InterleaveRgb(const std::uint8_t* planes, std::uint8_t* pixels, const std::size_t num_pixels)
+    -> std::size_t {
+  const auto count = num_pixels - (num_pixels % 16);
+  for (std::size_t i = 0; i < count; i += 16) {
+    uint8x16x3_t rgb;
+    rgb.val[0] = vld1q_u8(planes + i);
+    rgb.val[1] = vld1q_u8(planes + num_pixels + i);
+    rgb.val[2] = vld1q_u8(planes + 2 * num_pixels + i);
+    vst3q_u8(pixels + i * 3, rgb);
+  }
+  return count;
+}
+
+#endif
+
+}  // namespace detail
+
+/**
+ * @brief Splits interleaved pixels into one plane per channel.
+ *
+ * @param planes The start of the first plane. Each plane follows the one before it, @p num_pixels bytes apart.
+ * */
+inline void Deinterleave(const std::uint8_t* pixels, std::uint8_t* planes, const std::size_t num_pixels,
+                         const int channels) {
+  if (channels == 1) {
+    std::memcpy(planes, pixels, num_pixels);
+    return;
+  }
+  std::size_t done{};
+#if defined(AUGMENTATION_SSSE3)
+  if ((channels == 3) && detail::HasSsse3()) {
+    done = detail::DeinterleaveRgb(pixels, planes, num_pixels);
+  }
+#elif defined(AUGMENTATION_NEON)
+  if (channels == 3) {
+    done = detail::DeinterleaveRgb(pixels, planes, num_pixels);
+  }
+#endif
+  detail::DeinterleaveScalar(pixels, planes, done, num_pixels, num_pixels, channels);
+}
+
+/**
+ * @brief Merges one plane per channel into interleaved pixels.
+ *
+ * @param planes The start of the first plane. Each plane follows the one before it, @p num_pixels bytes apart.
+ * */
+inline void Interleave(const std::uint8_t* planes, std::uint8_t* pixels, const std::size_t num_pixels,
+                       const int channels) {
+  if (channels == 1) {
+    std::memcpy(pixels, planes, num_pixels);
+    return;
+  }
+  std::size_t done{};
+#if defined(AUGMENTATION_SSSE3)
+  if ((channels == 3) && detail::HasSsse3()) {
+    done = detail::InterleaveRgb(planes, pixels, num_pixels);
+  }
+#elif defined(AUGMENTATION_NEON)
+  if (channels == 3) {
+    done = detail::InterleaveRgb(planes, pixels, num_pixels);
+  }
+#endif
+  detail::InterleaveScalar(planes, pixels, done, num_pixels, num_pixels, channels);
+}
+
+}  // namespace interleave
@@ -3,14 +3,25 @@
 #include <pybind11/stl.h>
 
 #include <algorithm>
+#include <array>
+#include <condition_variable>
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <random>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <variant>
 #include <vector>
 
 #include "deps/stb_image.h"
 #include "deps/stb_image_write.h"
+#include "interleave.h"
 
 namespace {
 
@@ -24,6 +35,58 @@ struct Rect final {
   Scalar h{};
 };
 
+/**
+ * @brief The noise that is added to one sample.
+ * */
+struct SampleNoise final {
+  /**
+   * @brief The largest amount that a pixel is changed by, in either direction.
+   * */
+  int level{};
+
+  /**
+   * @brief Keys the noise of the sample, together with the channel, row and column of each pixel.
+   * */
+  std::uint32_t seed{};
+};
+
+/**
+ * @brief Hashes a 32-bit value to another, with good avalanche.
+ *
+ * @details This is the 'lowbias32' integer hash by Chris Wellons. It only uses 32-bit multiplies, shifts and xors, so
+ * that loops over it vectorize.
+ * */
+[[nodiscard]] constexpr auto Hash(std::uint32_t x) -> std::uint32_t {
+  x ^= x >> 16;
+  x *= 0x7feb352dU;
+  x ^= x >> 15;
+  x *= 0x846ca68bU;
+  x ^= x >> 16;
+  return x;
+}
+
+/**
+ * @brief Adds uniform noise in [-level, level] to a row of pixels and clamps the result.
+ *
+ * @details The noise is counter-based: the noise of each pixel is a hash of the key of its row and its column, so any
+ * pixel can be computed on its own. The result therefore does not depend on how the rows are split across threads,
+ * and the loop has no carried state, so the compiler can process many pixels at a time with SIMD.
+ * */
+void AddRowNoise(const std::uint8_t* input, std::uint8_t* output, const py::ssize_t w, const std::uint32_t row_key,
+                 const int level) {
+  // Note: The top 16 bits of the hash are scaled to the range of the noise, which keeps the math in 32 bits. The bias
+  //       that this leaves is far below what is visible for ranges of up to 511 values.
+  const auto span = static_cast<std::uint32_t>(2 * level + 1);
+#pragma omp simd
+  for (py::ssize_t x = 0; x < w; x++) {
+    const auto bits = Hash(row_key + static_cast<std::uint32_t>(x) * 0x9e3779b9U) >> 16;
+    const auto noise = static_cast<int>((bits * span) >> 16) - level;
+    output[x] = static_cast<std::uint8_t>(std::clamp(static_cast<int>(input[x]) + noise, 0, 255));
+  }
+}
+
+using ImageArray = py::array_t<std::uint8_t, py::array::forcecast | py::array::c_style>;
+
 class Transform final {
  public:
   Transform(int seed) : rng_(seed) {}
@@ -37,8 +100,7 @@ class Transform final {
     infill_rect_ = Rect<py::ssize_t>{x, y, w, h};
   }
 
-  [[nodiscard]] auto Call(const py::array_t<std::uint8_t, py::array::forcecast | py::array::c_style>& input)
-      -> py::tuple {
+  [[nodiscard]] auto Call(const ImageArray& input) -> py::tuple {
     const auto* shape = input.shape();
 
     if (input.ndim() != 3) {
@@ -49,50 +111,105 @@ class Transform final {
     const auto h = shape[1];
     const auto w = shape[2];
 
-    py::array_t<std::uint8_t, py::array::c_style | py::array::forcecast> target(
-        std::vector<py::ssize_t>{num_channels, infill_rect_.w, infill_rect_.h});
+    CheckInfillRect(h, w);
 
-    py::array_t<std::uint8_t, py::array::c_style | py::array::forcecast> img(
-        std::vector<py::ssize_t>{num_channels, h, w});
+    // Note: The settings are copied while the GIL is held, since another thread may change them once it is released.
+    const auto rect = infill_rect_;
 
-    std::uniform_int_distribution<int> noise_level_dist(noise_min_, noise_max_);
-    const auto noise_level = noise_level_dist(rng_);
-    std::uniform_int_distribution<int> noise_dist(-noise_level, noise_level);
+    ImageArray target(std::vector<py::ssize_t>{num_channels, rect.h, rect.w});
 
-    std::uniform_int_distribution<int> seed_dist(-1000, 1000);
-    const auto call_seed{seed_dist(rng_)};
-    for (auto c = 0; c < num_channels; c++) {
-      auto* plane = img.mutable_data(c);
+    ImageArray img(std::vector<py::ssize_t>{num_channels, h, w});
 
-      const auto* in_ptr = input.data(c);
+    const auto noise = NextNoise();
 
-#pragma omp parallel for
-      for (auto y = 0; y < h; y++) {
-        std::seed_seq seed{y, c, call_seed};
-        std::minstd_rand rng(seed);
-        constexpr auto warmup{16};
-        for (auto i = 0; i < warmup; i++) {
-          (void)rng();
-        }
+    const auto* input_ptr = input.data();
+    auto* img_ptr = img.mutable_data();
+    auto* target_ptr = target.mutable_data();
 
-        for (auto x = 0; x < w; x++) {
-          const auto value = std::clamp(static_cast<int>(in_ptr[y * w + x]) + noise_dist(rng), 0, 255);
-          plane[y * w + x] = static_cast<std::uint8_t>(value);
+    {
+      py::gil_scoped_release release;
+      Apply(input_ptr, img_ptr, target_ptr, num_channels, h, w, rect, noise, true);
+    }
+
+    return py::make_tuple(img, target);
+  }
+
+  /**
+   * @brief Transforms a batch of samples at once, in parallel across the samples.
+   *
+   * @param input Either an NCHW array, or a list of CHW arrays that all have the same shape.
+   *
+   * @return The NCHW inputs and targets.
+   *
+   * @note The noise of each sample depends only on the seed of the transform and the position of the sample in the
+   * sequence of samples that the transform has seen, not on the number of threads.
+   * */
+  [[nodiscard]] auto Batch(const py::object& input) -> py::tuple {
+    std::vector<ImageArray> samples;
+    std::vector<const std::uint8_t*> sources;
+    std::array<py::ssize_t, 3> shape{};
+
+    if (py::isinstance<py::list>(input)) {
+      for (const auto& item : input.cast<py::list>()) {
+        auto& sample = samples.emplace_back(item.cast<ImageArray>());
+        if (sample.ndim() != 3) {
+          throw std::runtime_error("Only 3 axis tensors are supported in a list of samples.");
+        }
+        const std::array<py::ssize_t, 3> sample_shape{sample.shape()[0], sample.shape()[1], sample.shape()[2]};
+        if (sources.empty()) {
+          shape = sample_shape;
+        } else if (sample_shape != shape) {
+          throw std::runtime_error("All samples of a batch must have the same shape.");
         }
+        sources.emplace_back(sample.data());
       }
+    } else {
+      auto& batch = samples.emplace_back(input.cast<ImageArray>());
+      if (batch.ndim() != 4) {
+        throw std::runtime_error("Only 4 axis tensors are supported for batches.");
+      }
+      shape = {batch.shape()[1], batch.shape()[2], batch.shape()[3]};
+      for (py::ssize_t i = 0; i < batch.shape()[0]; i++) {
+        sources.emplace_back(batch.data(i));
+      }
+    }
 
-      auto* target_plane = target.mutable_data(c);
-#pragma omp parallel for
-      for (auto y = 0; y < infill_rect_.h; y++) {
-        for (auto x = 0; x < infill_rect_.w; x++) {
-          const auto value = in_ptr[(infill_rect_.y + y) * w + (infill_rect_.x + x)];
-          target_plane[y * infill_rect_.w + x] = value;
-          plane[(infill_rect_.y + y) * w + (infill_rect_.x + x)] = 0;
-        }
+    if (sources.empty()) {
+      throw std::runtime_error("Batch is empty.");
+    }
+
+    const auto n = static_cast<py::ssize_t>(sources.size());
+    const auto [num_channels, h, w] = shape;
+
+    CheckInfillRect(h, w);
+
+    const auto rect = infill_rect_;
+
+    ImageArray imgs(std::vector<py::ssize_t>{n, num_channels, h, w});
+    ImageArray targets(std::vector<py::ssize_t>{n, num_channels, rect.h, rect.w});
+
+    // Note: The noise is drawn in the order of the samples before any work is split across threads, which keeps it
+    //       deterministic.
+    std::vector<SampleNoise> noise(sources.size());
+    for (auto& sample_noise : noise) {
+      sample_noise = NextNoise();
+    }
+
+    auto* imgs_ptr = imgs.mutable_data();
+    auto* targets_ptr = targets.mutable_data();
+    const auto img_size = num_channels * h * w;
+    const auto target_size = num_channels * rect.h * rect.w;
+
+    {
+      py::gil_scoped_release release;
+#pragma omp parallel for schedule(dynamic)
+      for (py::ssize_t i = 0; i < n; i++) {
+        Apply(sources[i], imgs_ptr + i * img_size, targets_ptr + i * target_size, num_channels, h, w, rect, noise[i],
+              false);
       }
     }
 
-    return py::make_tuple(img, target);
+    return py::make_tuple(imgs, targets);
   }
 
   [[nodiscard]] auto Reconstruct(const py::array_t<std::uint8_t, py::array::forcecast | py::array::c_style>& input,
@@ -106,7 +223,9 @@ class Transform final {
       throw std::runtime_error("The number of channels for the image and infill must be the same.");
     }
 
-    if ((infill.shape()[2] != infill_rect_.w) || (infill.shape()[1] != infill_rect_.h)) {
+    const auto rect = infill_rect_;
+
+    if ((infill.shape()[2] != rect.w) || (infill.shape()[1] != rect.h)) {
       throw std::runtime_error("Infill size does not match transform settings.");
     }
 
@@ -114,24 +233,91 @@ class Transform final {
     const auto h = input.shape()[1];
     const auto w = input.shape()[2];
 
+    CheckInfillRect(h, w);
+
     py::array_t<std::uint8_t, py::array::forcecast | py::array::c_style> output(
         std::vector<py::ssize_t>{num_channels, h, w});
 
-    for (auto c = 0; c < num_channels; c++) {
-      const auto* in_ptr = input.data(c);
-      const auto* infill_ptr = infill.data(c);
-      auto* out_ptr = output.mutable_data(c);
-      std::memcpy(out_ptr, in_ptr, w * h);
-      for (auto y = 0; y < infill_rect_.h; y++) {
-        auto* out_row = out_ptr + (infill_rect_.y + y) * w + infill_rect_.x;
-        const auto* infill_row = infill_ptr + y * infill_rect_.w;
-        std::memcpy(out_row, infill_row, infill_rect_.w);
+    const auto* in_base = input.data();
+    const auto* infill_base = infill.data();
+    auto* out_base = output.mutable_data();
+
+    {
+      py::gil_scoped_release release;
+
+      for (auto c = 0; c < num_channels; c++) {
+        const auto* in_ptr = in_base + c * h * w;
+        const auto* infill_ptr = infill_base + c * rect.h * rect.w;
+        auto* out_ptr = out_base + c * h * w;
+        std::memcpy(out_ptr, in_ptr, w * h);
+        for (auto y = 0; y < rect.h; y++) {
+          auto* out_row = out_ptr + (rect.y + y) * w + rect.x;
+          const auto* infill_row = infill_ptr + y * rect.w;
+          std::memcpy(out_row, infill_row, rect.w);
+        }
       }
     }
 
     return output;
   }
 
+  [[nodiscard]] auto InfillRect() const -> const Rect<py::ssize_t>& { return infill_rect_; }
+
+  /**
+   * @brief Draws the noise of the next sample.
+   * */
+  [[nodiscard]] auto NextNoise() -> SampleNoise {
+    std::uniform_int_distribution<int> noise_level_dist(noise_min_, noise_max_);
+    const auto noise_level = noise_level_dist(rng_);
+    std::uniform_int_distribution<std::uint32_t> seed_dist;
+    return SampleNoise{noise_level, seed_dist(rng_)};
+  }
+
+  void CheckInfillRect(const py::ssize_t h, const py::ssize_t w) const {
+    if ((infill_rect_.x < 0) || (infill_rect_.y < 0) || ((infill_rect_.x + infill_rect_.w) > w) ||
+        ((infill_rect_.y + infill_rect_.h) > h)) {
+      throw std::runtime_error("Infill rectangle does not fit into the image.");
+    }
+  }
+
+  /**
+   * @brief Adds noise to a CHW image and cuts out the infill rectangle as the target.
+   *
+   * @note This does not touch any Python objects, so it may run without the GIL.
+   *
+   * @param parallel Whether to split the rows across threads. Batches are split across samples instead.
+   * */
+  static void Apply(const std::uint8_t* input, std::uint8_t* img, std::uint8_t* target,
+                    const py::ssize_t num_channels, const py::ssize_t h, const py::ssize_t w,
+                    const Rect<py::ssize_t>& rect, const SampleNoise& noise, const bool parallel) {
+    for (auto c = 0; c < num_channels; c++) {
+      auto* plane = img + c * h * w;
+
+      const auto* in_ptr = input + c * h * w;
+
+      if (noise.level == 0) {
+        std::memcpy(plane, in_ptr, h * w);
+      } else {
+        const auto channel_key = Hash(noise.seed ^ Hash(static_cast<std::uint32_t>(c)));
+#pragma omp parallel for if (parallel)
+        for (auto y = 0; y < h; y++) {
+          const auto row_key = Hash(channel_key + static_cast<std::uint32_t>(y) * 0x85ebca6bU);
+          AddRowNoise(in_ptr + y * w, plane + y * w, w, row_key, noise.level);
+        }
+      }
+
+      auto* target_plane = target + c * rect.h * rect.w;
+#pragma omp parallel for if (parallel)
+      for (auto y = 0; y < rect.h; y++) {
+        for (auto x = 0; x < rect.w; x++) {
+          const auto value = in_ptr[(rect.y + y) * w + (rect.x + x)];
+          target_plane[y * rect.w + x] = value;
+          plane[(rect.y + y) * w + (rect.x + x)] = 0;
+        }
+      }
+    }
+  }
+
  private:
   Rect<py::ssize_t> infill_rect_{};
 
@@ -142,35 +328,43 @@ class Transform final {
   std::minstd_rand rng_;
 };
 
-auto OpenImage(const char* path) -> py::array_t<std::uint8_t, py::array::c_style> {
+auto OpenImage(const char* path, const int c) -> py::array_t<std::uint8_t, py::array::c_style> {
+  if ((c != 1) && (c != 3)) {
+    throw std::runtime_error("Only 1 or 3 channels are supported.");
+  }
+
   int w{};
   int h{};
-  constexpr auto c{3};
-  auto* pixels = stbi_load(path, &w, &h, nullptr, c);
+  std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> pixels(nullptr, &stbi_image_free);
+  {
+    py::gil_scoped_release release;
+    pixels.reset(stbi_load(path, &w, &h, nullptr, c));
+  }
   if (!pixels) {
     std::ostringstream stream;
     stream << "Failed to open '" << path << "'";
     throw std::runtime_error(stream.str());
   }
 
-  py::array_t<std::uint8_t, py::array::c_style> output(std::vector<int>{c, h, w});
-
-  auto* dst_r = output.mutable_data(0);
-  auto* dst_g = output.mutable_data(1);
-  auto* dst_b = output.mutable_data(2);
+  const std::vector<py::ssize_t> shape{c, h, w};
 
-  for (int i = 0; i < c; i++) {
-    for (int j = 0; j < h; j++) {
-      for (auto k = 0; k < w; k++) {
-        auto pixel = &pixels[(j * w + k) * c];
-        dst_r[j * w + k] = pixel[0];
-        dst_g[j * w + k] = pixel[1];
-        dst_b[j * w + k] = pixel[2];
-      }
-    }
+  // Note: A single channel image is already planar, so the array takes over the decoded pixels without a copy.
+  if (c == 1) {
+    auto* data = pixels.release();
+    py::capsule owner(data, [](void* p) { stbi_image_free(p); });
+    return py::array_t<std::uint8_t, py::array::c_style>(shape, data, owner);
   }
 
-  stbi_image_free(pixels);
+  // Note: The array can only be allocated with the GIL held, once the size of the image is known.
+  py::array_t<std::uint8_t, py::array::c_style> output(shape);
+
+  auto* base = output.mutable_data();
+
+  {
+    py::gil_scoped_release release;
+    interleave::Deinterleave(pixels.get(), base, static_cast<std::size_t>(w) * h, c);
+    pixels.reset();
+  }
 
   return output;
 }
@@ -184,30 +378,458 @@ void SavePng(const char* path, const py::array_t<std::uint8_t, py::array::forcec
   const auto h = buffer.shape()[1];
   const auto w = buffer.shape()[2];
 
-  std::vector<std::uint8_t> tmp(w * h * c);
+  if ((c != 1) && (c != 3)) {
+    throw std::runtime_error("Only 1 or 3 channels are supported.");
+  }
 
-  auto* src_r = buffer.data(0);
-  auto* src_g = buffer.data(1);
-  auto* src_b = buffer.data(2);
+  const auto* base = buffer.data();
 
-  for (auto i = 0; i < c; i++) {
-    for (auto j = 0; j < h; j++) {
-      for (auto k = 0; k < w; k++) {
-        auto pixel = &tmp[(j * w + k) * c];
-        pixel[0] = src_r[j * w + k];
-        pixel[1] = src_g[j * w + k];
-        pixel[2] = src_b[j * w + k];
-      }
+  bool saved{};
+  {
+    py::gil_scoped_release release;
+
+    // Note: A single channel image is written straight from the array, since planar and interleaved are the same.
+    std::vector<std::uint8_t> tmp;
+    const auto* pixels = base;
+    if (c > 1) {
+      tmp.resize(w * h * c);
+      interleave::Interleave(base, tmp.data(), static_cast<std::size_t>(w) * h, static_cast<int>(c));
+      pixels = tmp.data();
     }
+
+    saved = stbi_write_png(path, w, h, c, pixels, w * c) != 0;
   }
 
-  stbi_write_png(path, w, h, c, tmp.data(), w * c);
+  if (!saved) {
+    std::ostringstream stream;
+    stream << "Failed to save '" << path << "'";
+    throw std::runtime_error(stream.str());
+  }
 }
 
+/**
+ * @brief The float inputs and targets of one batch.
+ * */
+struct Batch final {
+  std::vector<float> inputs;
+
+  std::vector<float> targets;
+};
+
+/**
+ * @brief Keeps the buffers of batches that Python no longer refers to, so that later batches reuse them.
+ * */
+class BatchPool final : public std::enable_shared_from_this<BatchPool> {
+ public:
+  /**
+   * @brief Takes a free batch, or allocates one if there is none.
+   *
+   * @note The batch goes back to the pool once the last reference to it is released, even if that happens after the
+   * loader has been destroyed.
+   * */
+  [[nodiscard]] auto Take(const std::size_t inputs_size, const std::size_t targets_size) -> std::shared_ptr<Batch> {
+    std::unique_ptr<Batch> batch;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!free_.empty()) {
+        batch = std::move(free_.back());
+        free_.pop_back();
+      }
+    }
+    if (!batch) {
+      batch = std::make_unique<Batch>();
+    }
+    batch->inputs.resize(inputs_size);
+    batch->targets.resize(targets_size);
+
+    std::weak_ptr<BatchPool> pool = shared_from_this();
+    return std::shared_ptr<Batch>(batch.release(), [pool](Batch* released) {
+      std::unique_ptr<Batch> owned(released);
+      if (auto alive = pool.lock()) {
+        std::lock_guard<std::mutex> lock(alive->mutex_);
+        alive->free_.emplace_back(std::move(owned));
+      }
+    });
+  }
+
+ private:
+  std::mutex mutex_;
+
+  std::vector<std::unique_ptr<Batch>> free_;
+};
+
+/**
+ * @brief Loads batches of transformed samples on a pool of threads, ahead of the training loop.
+ *
+ * @details Each epoch visits every image once, in an order that is shuffled by the seed and the number of the epoch.
+ * The noise of each sample is drawn from the transform when the epoch starts, so the batches do not depend on the
+ * number of threads. Workers decode, transform and convert samples straight into the float buffers of the batch that
+ * they belong to, and stay at most a fixed number of batches ahead of Python. Neither the workers nor the wait for a
+ * batch hold the GIL.
+ * */
+class Loader final {
+ public:
+  using Source = std::variant<std::string, std::vector<std::string>>;
+
+  /**
+   * @param source A directory to load all PNG images from, or a list of image paths.
+   * @param num_threads The number of decoding threads. If zero, one per hardware thread is used.
+   * @param prefetch The number of batches to prepare ahead of the one that Python is waiting for.
+   * */
+  Loader(const Source& source, Transform& transform, const py::ssize_t batch_size, const int channels,
+         const bool shuffle, const std::uint64_t seed, const int num_threads, const int prefetch, const bool drop_last)
+      : transform_(&transform),
+        batch_size_(batch_size),
+        channels_(channels),
+        shuffle_(shuffle),
+        seed_(seed),
+        num_threads_((num_threads > 0) ? num_threads : std::max(1U, std::thread::hardware_concurrency())),
+        prefetch_(prefetch),
+        drop_last_(drop_last),
+        pool_(std::make_shared<BatchPool>()) {
+    if ((channels != 1) && (channels != 3)) {
+      throw std::runtime_error("Only 1 or 3 channels are supported.");
+    }
+    if (batch_size < 1) {
+      throw std::runtime_error("Batch size must be at least 1.");
+    }
+    if (prefetch < 1) {
+      throw std::runtime_error("At least one batch must be prefetched.");
+    }
+
+    if (const auto* directory = std::get_if<std::string>(&source)) {
+      for (const auto& entry : std::filesystem::directory_iterator(*directory)) {
+        if (entry.is_regular_file() && (entry.path().extension() == ".png")) {
+          paths_.emplace_back(entry.path().string());
+        }
+      }
+      // Note: The order of a directory listing is not defined, so it is sorted to keep epochs reproducible.
+      std::sort(paths_.begin(), paths_.end());
+    } else {
+      paths_ = std::get<std::vector<std::string>>(source);
+    }
+
+    if (paths_.empty()) {
+      throw std::runtime_error("No images to load.");
+    }
+
+    if (!stbi_info(paths_[0].c_str(), &width_, &height_, nullptr)) {
+      std::ostringstream stream;
+      stream << "Failed to open '" << paths_[0] << "'";
+      throw std::runtime_error(stream.str());
+    }
+  }
+
+  Loader(const Loader&) = delete;
+
+  Loader(Loader&&) = delete;
+
+  ~Loader() { Stop(); }
+
+  auto operator=(const Loader&) -> Loader& = delete;
+
+  auto operator=(Loader&&) -> Loader& = delete;
+
+  /**
+   * @brief The number of batches in an epoch.
+   * */
+  [[nodiscard]] auto Len() const -> py::ssize_t {
+    const auto n = static_cast<py::ssize_t>(paths_.size());
+    return drop_last_ ? (n / batch_size_) : ((n + batch_size_ - 1) / batch_size_);
+  }
+
+  [[nodiscard]] auto NumSamples() const -> py::ssize_t { return static_cast<py::ssize_t>(paths_.size()); }
+
+  /**
+   * @brief Starts a new epoch, abandoning the rest of the current one.
+   * */
+  auto Iter() -> Loader& {
+    Start();
+    return *this;
+  }
+
+  /**
+   * @brief Waits for the next batch of the epoch.
+   *
+   * @return The NCHW inputs and targets, as floats scaled to [0, 1]. The arrays share a buffer that is reused once
+   * neither of them is referenced anymore.
+   * */
+  [[nodiscard]] auto Next() -> py::tuple {
+    std::shared_ptr<Batch> batch;
+    py::ssize_t size{};
+    std::string error;
+
+    {
+      py::gil_scoped_release release;
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (next_batch_ < num_batches_) {
+        auto& slot = slots_[next_batch_ % prefetch_];
+        ready_.wait(lock, [this, &slot]() { return !error_.empty() || ((slot.size > 0) && (slot.done == slot.size)); });
+        error = error_;
+        if (error.empty()) {
+          batch = std::move(slot.batch);
+          size = slot.size;
+          slot = Slot{};
+          next_batch_++;
+        }
+      }
+    }
+
+    if (!error.empty()) {
+      Stop();
+      throw std::runtime_error(error);
+    }
+
+    if (!batch) {
+      throw py::stop_iteration();
+    }
+
+    const auto owner = [](const std::shared_ptr<Batch>& shared) {
+      return py::capsule(new std::shared_ptr<Batch>(shared),
+                         [](void* p) { delete static_cast<std::shared_ptr<Batch>*>(p); });
+    };
+
+    work_.notify_all();
+
+    py::array_t<float, py::array::c_style> inputs(std::vector<py::ssize_t>{size, channels_, height_, width_},
+                                                  batch->inputs.data(), owner(batch));
+    py::array_t<float, py::array::c_style> targets(std::vector<py::ssize_t>{size, channels_, rect_.h, rect_.w},
+                                                   batch->targets.data(), owner(batch));
+
+    return py::make_tuple(inputs, targets);
+  }
+
+ protected:
+  /**
+   * @brief A batch that is being assembled.
+   * */
+  struct Slot final {
+    std::shared_ptr<Batch> batch;
+
+    py::ssize_t size{};
+
+    py::ssize_t done{};
+  };
+
+  /**
+   * @brief The buffers that a worker reuses between samples.
+   * */
+  struct Scratch final {
+    std::vector<std::uint8_t> planes;
+
+    std::vector<std::uint8_t> noisy;
+
+    std::vector<std::uint8_t> target;
+  };
+
+  void Start() {
+    Stop();
+
+    const auto n = static_cast<py::ssize_t>(paths_.size());
+
+    rect_ = transform_->InfillRect();
+    transform_->CheckInfillRect(height_, width_);
+
+    order_.resize(paths_.size());
+    std::iota(order_.begin(), order_.end(), std::size_t{});
+    if (shuffle_) {
+      std::seed_seq seed{static_cast<std::uint32_t>(seed_), static_cast<std::uint32_t>(seed_ >> 32),
+                         static_cast<std::uint32_t>(epoch_)};
+      std::mt19937_64 rng(seed);
+      std::shuffle(order_.begin(), order_.end(), rng);
+    }
+
+    num_batches_ = Len();
+    num_samples_ = drop_last_ ? (num_batches_ * batch_size_) : n;
+
+    // Note: The noise is drawn here, with the GIL held, since the transform may be shared with Python code.
+    noise_.resize(static_cast<std::size_t>(num_samples_));
+    for (auto& sample_noise : noise_) {
+      sample_noise = transform_->NextNoise();
+    }
+
+    next_sample_ = 0;
+    next_batch_ = 0;
+    slots_.assign(static_cast<std::size_t>(prefetch_), Slot{});
+    error_.clear();
+    stopping_ = false;
+    epoch_++;
+
+    for (int i = 0; i < num_threads_; i++) {
+      workers_.emplace_back([this]() { Work(); });
+    }
+  }
+
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    work_.notify_all();
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+    workers_.clear();
+  }
+
+  void Work() {
+    Scratch scratch;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true) {
+      work_.wait(lock, [this]() {
+        return stopping_ || ((next_sample_ < num_samples_) && ((next_sample_ / batch_size_) < (next_batch_ + prefetch_)));
+      });
+      if (stopping_) {
+        return;
+      }
+
+      const auto index = next_sample_++;
+      const auto batch_index = index / batch_size_;
+      auto& slot = slots_[batch_index % prefetch_];
+      if (!slot.batch) {
+        slot.size = std::min(batch_size_, num_samples_ - batch_index * batch_size_);
+        slot.batch = pool_->Take(static_cast<std::size_t>(batch_size_ * channels_ * height_ * width_),
+                                 static_cast<std::size_t>(batch_size_ * channels_ * rect_.h * rect_.w));
+      }
+      auto* batch = slot.batch.get();
+
+      lock.unlock();
+      auto error = LoadSample(order_[index], noise_[index], *batch, index % batch_size_, scratch);
+      lock.lock();
+
+      if (!error.empty() && error_.empty()) {
+        error_ = std::move(error);
+      }
+      if (++slot.done == slot.size) {
+        ready_.notify_all();
+      }
+    }
+  }
+
+  /**
+   * @brief Decodes, transforms and converts one sample into its place in a batch.
+   *
+   * @return An error message, or an empty string on success.
+   * */
+  [[nodiscard]] auto LoadSample(const std::size_t path_index, const SampleNoise& noise, Batch& batch,
+                                const py::ssize_t position, Scratch& scratch) const -> std::string {
+    const auto& path = paths_[path_index];
+
+    int w{};
+    int h{};
+    std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> pixels(stbi_load(path.c_str(), &w, &h, nullptr, channels_),
+                                                                &stbi_image_free);
+    if (!pixels) {
+      return "Failed to open '" + path + "'";
+    }
+    if ((w != width_) || (h != height_)) {
+      std::ostringstream stream;
+      stream << "'" << path << "' is " << w << "x" << h << ", but the first image is " << width_ << "x" << height_;
+      return stream.str();
+    }
+
+    const auto image_size = static_cast<std::size_t>(channels_) * h * w;
+    const auto target_size = static_cast<std::size_t>(channels_ * rect_.h * rect_.w);
+
+    scratch.planes.resize(image_size);
+    scratch.noisy.resize(image_size);
+    scratch.target.resize(target_size);
+
+    interleave::Deinterleave(pixels.get(), scratch.planes.data(), static_cast<std::size_t>(w) * h, channels_);
+    pixels.reset();
+
+    Transform::Apply(scratch.planes.data(), scratch.noisy.data(), scratch.target.data(), channels_, h, w, rect_, noise,
+                     false);
+
+    ToFloat(scratch.noisy.data(), batch.inputs.data() + position * image_size, image_size);
+    ToFloat(scratch.target.data(), batch.targets.data() + position * target_size, target_size);
+
+    return std::string();
+  }
+
+  /**
+   * @brief Scales 8-bit values to floats in [0, 1].
+   * */
+  static void ToFloat(const std::uint8_t* input, float* output, const std::size_t size) {
+    constexpr auto scale{1.0F / 255.0F};
+#pragma omp simd
+    for (std::size_t i = 0; i < size; i++) {
+      output[i] = static_cast<float>(input[i]) * scale;
+    }
+  }
+
+ private:
+  Transform* transform_{};
+
+  std::vector<std::string> paths_;
+
+  py::ssize_t batch_size_{};
+
+  int channels_{};
+
+  bool shuffle_{};
+
+  std::uint64_t seed_{};
+
+  int num_threads_{};
+
+  py::ssize_t prefetch_{};
+
+  bool drop_last_{};
+
+  std::shared_ptr<BatchPool> pool_;
+
+  int width_{};
+
+  int height_{};
+
+  std::uint64_t epoch_{};
+
+  /**
+   * @brief The settings of the current epoch. They only change while no workers are running.
+   * */
+  Rect<py::ssize_t> rect_{};
+
+  std::vector<std::size_t> order_;
+
+  std::vector<SampleNoise> noise_;
+
+  py::ssize_t num_samples_{};
+
+  py::ssize_t num_batches_{};
+
+  std::mutex mutex_;
+
+  /**
+   * @brief Notified when a batch is complete or a sample failed.
+   * */
+  std::condition_variable ready_;
+
+  /**
+   * @brief Notified when there is room to work ahead, or when the workers must stop.
+   * */
+  std::condition_variable work_;
+
+  py::ssize_t next_sample_{};
+
+  py::ssize_t next_batch_{};
+
+  std::vector<Slot> slots_;
+
+  std::string error_;
+
+  bool stopping_{};
+
+  std::vector<std::thread> workers_;
+};
+
 }  // namespace
 
 PYBIND11_MODULE(augmentation, m) {
-  m.def("open_image", &OpenImage, py::arg("path"));
+  m.def("open_image", &OpenImage, py::arg("path"), py::arg("channels") = 3);
   m.def("save_png", &SavePng, py::arg("path"), py::arg("image"));
 
   py::class_<Transform>(m, "Transform")
@@ -215,5 +837,16 @@ PYBIND11_MODULE(augmentation, m) {
       .def("set_infill_rect", &Transform::SetInfillRect, py::arg("x"), py::arg("y"), py::arg("w"), py::arg("h"))
       .def("set_noise_range", &Transform::SetNoiseRange, py::arg("min_value"), py::arg("max_value"))
       .def("__call__", &Transform::Call, py::arg("input"))
+      .def("batch", &Transform::Batch, py::arg("input"))
       .def("reconstruct", &Transform::Reconstruct, py::arg("img"), py::arg("infill"));
+
+  py::class_<Loader>(m, "Loader")
+      .def(py::init<const Loader::Source&, Transform&, py::ssize_t, int, bool, std::uint64_t, int, int, bool>(),
+           py::arg("source"), py::arg("transform"), py::arg("batch_size"), py::arg("channels") = 3,
+           py::arg("shuffle") = false, py::arg("seed") = 0, py::arg("num_threads") = 0, py::arg("prefetch") = 2,
+           py::arg("drop_last") = false, py::keep_alive<1, 3>())
+      .def("__len__", &Loader::Len)
+      .def("__iter__", &Loader::Iter, py::return_value_policy::reference_internal)
+      .def("__next__", &Loader::Next)
+      .def_property_readonly("num_samples", &Loader::NumSamples);
 }
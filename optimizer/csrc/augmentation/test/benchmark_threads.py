@@ -0,0 +1,47 @@
+"""
+Measures how well image loading and augmentation scale across Python threads, which requires the native functions to
+release the GIL.
+
+Usage: python test/benchmark_threads.py <directory of PNG images> [max threads]
+"""
+import sys
+import time
+from concurrent.futures import ThreadPoolExecutor
+from pathlib import Path
+
+from augmentation import Transform, open_image
+
+def load(path: str, transform: Transform):
+    img = open_image(path)
+    return transform(img)
+
+def main():
+    root = Path(sys.argv[1] if len(sys.argv) > 1 else 'test')
+    max_threads = int(sys.argv[2]) if len(sys.argv) > 2 else 8
+    paths = [str(p) for p in sorted(root.glob('*.png'))]
+    if not paths:
+        print(f'No PNG images found in {root}.')
+        return
+
+    transform = Transform()
+    transform.set_infill_rect(x=0, y=0, w=16, h=16)
+    transform.set_noise_range(0, 16)
+
+    # Note: Each thread count loads the images several times so that short runs are not dominated by start-up.
+    work = paths * max(1, 256 // len(paths))
+
+    baseline = None
+    threads = 1
+    while threads <= max_threads:
+        start = time.perf_counter()
+        with ThreadPoolExecutor(max_workers=threads) as pool:
+            for _ in pool.map(lambda p: load(p, transform), work):
+                pass
+        elapsed = time.perf_counter() - start
+        rate = len(work) / elapsed
+        baseline = baseline or rate
+        print(f'{threads:2d} threads: {rate:8.1f} images/s ({rate / baseline:.2f}x)')
+        threads *= 2
+
+if __name__ == '__main__':
+    main()
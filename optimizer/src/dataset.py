@@ -5,21 +5,53 @@ from torch import unsqueeze
 from torchvision.transforms.v2 import functional as F
 
 # Note: This module is defined in 'csrc/'. You have to install it to your venv with `pip install csrc/augmentation`
-from augmentation import Transform, open_image
+from augmentation import Loader, Transform, open_image
 
 class Dataset(torch.utils.data.Dataset):
-    def __init__(self, root: str, transform: Transform):
+    def __init__(self, root: str, transform: Transform, channels: int = 3):
         self.paths: list[str] = []
         for entry in Path(root).glob('*.png'):
             self.paths.append(entry)
         self.transform = transform
+        self.channels = channels
 
     def __len__(self) -> int:
         return len(self.paths)
 
     def __getitem__(self, idx):
-        img = open_image(str(self.paths[idx]))
+        img = open_image(str(self.paths[idx]), channels=self.channels)
         img, target = self.transform(img)
         img = F.to_dtype(torch.from_numpy(img), scale=True)
         target = F.to_dtype(torch.from_numpy(target), scale=True)
-        return img, target
\ No newline at end of file
+        return img, target
+
+    def __getitems__(self, indices: list[int]):
+        # Note: The whole batch is transformed in one native call, which is parallel across the samples. It is split
+        #       back into samples, since a DataLoader passes the result of this to its collate function.
+        images = [open_image(str(self.paths[idx]), channels=self.channels) for idx in indices]
+        img, target = self.transform.batch(images)
+        img = F.to_dtype(torch.from_numpy(img), scale=True)
+        target = F.to_dtype(torch.from_numpy(target), scale=True)
+        return list(zip(img.unbind(0), target.unbind(0)))
+
+class NativeLoader:
+    """
+    Loads batches on native threads, which decode and transform the next few batches while the current one is used.
+    Unlike a DataLoader over the Dataset above, neither the workers nor the wait for a batch hold the GIL.
+    """
+    def __init__(self, root: str, transform: Transform, batch_size: int, channels: int = 3, shuffle: bool = False,
+                 seed: int = 0, num_threads: int = 0, prefetch: int = 2, drop_last: bool = False):
+        self.loader = Loader(root, transform, batch_size=batch_size, channels=channels, shuffle=shuffle, seed=seed,
+                             num_threads=num_threads, prefetch=prefetch, drop_last=drop_last)
+
+    def __len__(self) -> int:
+        return len(self.loader)
+
+    @property
+    def num_samples(self) -> int:
+        return self.loader.num_samples
+
+    def __iter__(self):
+        # Note: The arrays keep their buffer alive, and the buffer is reused once the tensors are released.
+        for img, target in self.loader:
+            yield torch.from_numpy(img), torch.from_numpy(target)
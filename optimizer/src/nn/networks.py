@@ -17,14 +17,16 @@ class _Block(nn.Module):
             return x
 
 class Network(nn.Module):
-    def __init__(self, n: int = 1):
+    def __init__(self, n: int = 1, channels: int = 3):
         super().__init__()
+        # The number of channels of the input image and of the prediction.
+        self.channels = channels
         self.e1 = nn.Sequential(
-            _Block(n=1, in_channels=3, out_channels=n*8, kernel_size=7),
+            _Block(n=1, in_channels=channels, out_channels=n*8, kernel_size=7),
             _Block(n, 8, 16, kernel_size=7)
         )
         self.e2 = nn.Sequential(
-            _Block(n=1, in_channels=3, out_channels=n*8, kernel_size=5),
+            _Block(n=1, in_channels=channels, out_channels=n*8, kernel_size=5),
             _Block(n, 8, 8, kernel_size=3),
             _Block(n, 8, 16, kernel_size=3),
             _Block(n, 16, 16, kernel_size=3),
@@ -49,7 +51,7 @@ class Network(nn.Module):
             _Block(n, 128, 64, kernel_size=1),
             _Block(n, 64, 64, kernel_size=1),
             _Block(n, 64, 16, kernel_size=1),
-            _Block(n=1, in_channels=16*n, out_channels=3, kernel_size=1, relu=False)
+            _Block(n=1, in_channels=16*n, out_channels=channels, kernel_size=1, relu=False)
         )
 
     def forward(self, x):
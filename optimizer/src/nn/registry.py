@@ -9,7 +9,10 @@ global registry
 registry: dict[str, Callable] = {
     'v1_x1': lambda: Network(n=1),
     'v1_x2': lambda: Network(n=2),
-    'v1_x4': lambda: Network(n=4)
+    'v1_x4': lambda: Network(n=4),
+    'v1_x1_gray': lambda: Network(n=1, channels=1),
+    'v1_x2_gray': lambda: Network(n=2, channels=1),
+    'v1_x4_gray': lambda: Network(n=4, channels=1)
 }
 
 def register_module(name: str, factory: Callable):
@@ -2,7 +2,6 @@ import signal
 import argparse
 
 from loguru import logger
-from torch.utils.data import DataLoader
 from torch import nn, device
 from torch import float32
 from torch import cuda
@@ -15,7 +14,7 @@ import zmq
 from augmentation import Transform
 
 from src.loop import Loop
-from src.dataset import Dataset
+from src.dataset import NativeLoader
 from src.tasks.optimizer import Optimizer
 from src.tasks.evaluator import Evaluator
 from src.nn.registry import create_module
@@ -28,9 +27,9 @@ def on_signal(signum: int, frame):
     global keep_going
     keep_going = False
 
-def export_module(module: nn.Module):
+def export_module(module: nn.Module, channels: int):
     module = module.cpu().eval()
-    input_ = torch.randn(1, 3, 120, 120, requires_grad=True)
+    input_ = torch.randn(1, channels, 120, 120, requires_grad=True)
     torch.onnx.export(module,
                       input_,
                       'model.onnx',
@@ -39,7 +38,9 @@ def export_module(module: nn.Module):
                       do_constant_folding=True,
                       input_names=['input'],
                       output_names=['output'],
-                      dynamic_axes={ 'input': { 0: 'batch_size' }, 'output': { 0: 'batch_size' }})
+                      # The spatial axes are dynamic so that the pipeline can run the network over whole frames.
+                      dynamic_axes={ 'input': { 0: 'batch_size', 2: 'height', 3: 'width' },
+                                     'output': { 0: 'batch_size', 2: 'height', 3: 'width' }})
 
 def main():
     parser = argparse.ArgumentParser()
@@ -65,16 +66,17 @@ def main():
     transform.set_infill_rect(x=40, y=40, w=40, h=40)
     transform.set_noise_range(0, 0)
 
-    train_data = Dataset(root='data/train', transform=transform)
-    test_data = Dataset(root='data/test', transform=transform)
+    module = create_module(args.model)
+    # Note: Single channel models are trained on images that are converted to grayscale when they are loaded.
+    channels = getattr(module, 'channels', 3)
 
-    train_loader = DataLoader(dataset=train_data, batch_size=args.batch_size, shuffle=True)#, num_workers=2)#, pin_memory=pin_memory, pin_memory_device=dev)
-    test_loader = DataLoader(dataset=test_data, batch_size=args.batch_size, shuffle=False)#, num_workers=2)#, pin_memory=pin_memory, pin_memory_device=dev)
+    train_loader = NativeLoader(root='data/train', transform=transform, batch_size=args.batch_size, channels=channels,
+                                shuffle=True)
+    test_loader = NativeLoader(root='data/test', transform=transform, batch_size=args.batch_size, channels=channels)
 
-    module = create_module(args.model)
     module = module.to(dev)
-    logger.info(f'Training data has {len(train_data)} samples.')
-    logger.info(f'Test data has {len(test_data)} samples.')
+    logger.info(f'Training data has {train_loader.num_samples} samples.')
+    logger.info(f'Test data has {test_loader.num_samples} samples.')
     logger.info('Starting loop.')
     zmq_context = zmq.Context()
     reporter = ZmqReportWriter(transform, zmq_context)
@@ -86,7 +88,7 @@ def main():
         logger.info('Step complete.')
     logger.info('Loop terminated.')
     logger.info('Exporting module.')
-    export_module(module)
+    export_module(module, channels)
     logger.info('Exiting')
 
 main()
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include "camera.h"
+
+#include <spdlog/spdlog.h>
+
+#include <sstream>
+#include <thread>
+#include <utility>
+
+auto CameraOptions::Parse(const std::string& spec,
+                          const CameraOptions& defaults)
+    -> std::optional<CameraOptions> {
+  auto options = defaults;
+
+  std::istringstream stream(spec);
+  std::string pair;
+
+  while (std::getline(stream, pair, ',')) {
+    // Note: Only the first '=' separates the key, since values such as bind
+    // addresses may contain other characters.
+    const auto separator = pair.find('=');
+    if (separator == std::string::npos) {
+      SPDLOG_ERROR("Expected 'key=value' in camera settings, got '{}'.", pair);
+      return std::nullopt;
+    }
+
+    const auto key = pair.substr(0, separator);
+    const auto value = pair.substr(separator + 1);
+
+    try {
+      if (key == "source") {
+        options.source = value;
+      } else if (key == "width") {
+        options.width = std::stoi(value);
+      } else if (key == "height") {
+        options.height = std::stoi(value);
+      } else if (key == "interval") {
+        options.interval = std::stof(value);
+      } else if (key == "rate") {
+        const auto rate = ParseRate(value);
+        if (!rate) {
+          return std::nullopt;
+        }
+        options.rate = *rate;
+      } else if (key == "loop") {
+        options.loop = (value == "1") || (value == "true");
+      } else if (key == "crop") {
+        options.transform.crop = FrameTransform::ParseCrop(value);
+        if (!options.transform.crop) {
+          return std::nullopt;
+        }
+      } else if (key == "resize") {
+        options.transform.size = FrameTransform::ParseSize(value);
+        if (!options.transform.size) {
+          return std::nullopt;
+        }
+      } else if (key == "interpolation") {
+        const auto interpolation = FrameTransform::ParseInterpolation(value);
+        if (!interpolation) {
+          return std::nullopt;
+        }
+        options.transform.interpolation = *interpolation;
+      } else if (key == "gray") {
+        options.transform.gray = (value == "1") || (value == "true");
+      } else if (key == "anomaly_probability") {
+        options.synthetic.anomaly_probability = std::stof(value);
+      } else if (key == "max_anomalies") {
+        options.synthetic.max_anomalies = std::stoi(value);
+      } else if (key == "seed") {
+        options.synthetic.seed = std::stoull(value);
+      } else if (key == "ground_truth") {
+        options.synthetic.ground_truth_path = value;
+      } else if (key == "topic") {
+        options.topic = value;
+      } else if (key == "bind") {
+        options.bind_address = value;
+      } else {
+        SPDLOG_ERROR("Unknown camera setting '{}'.", key);
+        return std::nullopt;
+      }
+    } catch (const std::exception&) {
+      SPDLOG_ERROR("Invalid value '{}' for camera setting '{}'.", value, key);
+      return std::nullopt;
+    }
+  }
+
+  if (options.interval < 0.0F) {
+    SPDLOG_ERROR("Interval {} is invalid since it is negative.",
+                 options.interval);
+    return std::nullopt;
+  }
+
+  if ((options.synthetic.anomaly_probability < 0.0F) ||
+      (options.synthetic.anomaly_probability > 1.0F)) {
+    SPDLOG_ERROR("Anomaly probability {} is not between 0 and 1.",
+                 options.synthetic.anomaly_probability);
+    return std::nullopt;
+  }
+
+  return options;
+}
+
+auto CameraOptions::Name() const -> std::string {
+  return topic.empty() ? source : topic;
+}
+
+auto CameraOptions::ParseRate(const std::string& name)
+    -> std::optional<CaptureRate> {
+  if (name == "interval") {
+    return CaptureRate::kInterval;
+  }
+  if (name == "native") {
+    return CaptureRate::kNative;
+  }
+  if (name == "max") {
+    return CaptureRate::kMax;
+  }
+  SPDLOG_ERROR("Unknown capture rate '{}', expected interval, native or max.",
+               name);
+  return std::nullopt;
+}
+
+Camera::Camera(const std::size_t index, CameraOptions options,
+               std::shared_ptr<Publisher> publisher)
+    : index_(index),
+      options_(std::move(options)),
+      publisher_(std::move(publisher)) {}
+
+auto Camera::Open() -> bool {
+  SPDLOG_INFO("Opening '{}' at {}x{} every {} seconds.", options_.source,
+              options_.width, options_.height, options_.interval);
+
+  if (SyntheticSource::IsSynthetic(options_.source)) {
+    source_ = SyntheticSource::Open(options_.source, options_.width,
+                                    options_.height, options_.synthetic);
+  } else {
+    source_ =
+        FrameSource::Open(options_.source, options_.width, options_.height);
+  }
+
+  return source_ != nullptr;
+}
+
+void Camera::Capture(FrameRing& ring) {
+  const auto interval = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<float>(Interval()));
+
+  auto deadline = clock::now();
+
+  CapturedFrame frame;
+
+  while (true) {
+    std::this_thread::sleep_until(deadline);
+
+    if (!source_->Read(frame.image)) {
+      if (!options_.loop || !source_->Rewind() || !source_->Read(frame.image)) {
+        SPDLOG_INFO("'{}' has no more frames.", options_.Name());
+        return;
+      }
+      SPDLOG_INFO("'{}' starts over.", options_.Name());
+    }
+
+    frame.camera = index_;
+    frame.sequence = sequence_++;
+    frame.capture_time_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
+
+    num_captured_++;
+
+    (void)ring.Push(frame);
+
+    if (interval.count() == 0) {
+      continue;
+    }
+
+    deadline += interval;
+
+    const auto now = clock::now();
+    if (now > deadline) {
+      const auto missed = (now - deadline) / interval + 1;
+      SPDLOG_WARN(
+          "'{}' fell {} [ms] behind schedule, skipping {} frames.",
+          options_.Name(),
+          std::chrono::duration_cast<std::chrono::milliseconds>(now - deadline)
+              .count(),
+          missed);
+      deadline += interval * missed;
+    }
+  }
+}
+
+auto Camera::Interval() const -> float {
+  switch (options_.rate) {
+    case CaptureRate::kInterval:
+      break;
+    case CaptureRate::kNative:
+      if (const auto native = source_->NativeInterval()) {
+        return *native;
+      }
+      SPDLOG_WARN("'{}' has no native frame rate, using the interval.",
+                  options_.Name());
+      break;
+    case CaptureRate::kMax:
+      return 0.0F;
+  }
+  return options_.interval;
+}
+
+void Camera::Publish(const FrameHeader& header,
+                     const std::vector<std::uint8_t>& buffer) {
+  std::lock_guard<std::mutex> lock(publish_mutex_);
+
+  // Note: With several encode threads, frames may finish out of order. A frame
+  // that is older than one that was already sent is of no use.
+  if (last_published_ && (header.sequence < *last_published_)) {
+    num_late_++;
+    return;
+  }
+
+  last_published_ = header.sequence;
+
+  if (publisher_->Send(options_.topic, header, buffer)) {
+    num_published_++;
+  }
+}
+
+void Camera::LogStats(const FrameRing& ring) {
+  const auto captured = num_captured_.load();
+  const auto published = num_published_.load();
+  const auto now = clock::now();
+  const auto elapsed =
+      std::chrono::duration<double>(now - last_stats_time_).count();
+  SPDLOG_INFO(
+      "'{}' captured {} frames ({:.1f} fps) and published {} ({:.1f} fps), "
+      "dropped {} from the queue and {} that finished late.",
+      options_.Name(), captured, (captured - last_captured_) / elapsed,
+      published, (published - last_published_count_) / elapsed,
+      ring.NumDropped(index_), num_late_.load());
+  last_stats_time_ = now;
+  last_captured_ = captured;
+  last_published_count_ = published;
+}
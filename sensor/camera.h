@@ -0,0 +1,183 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "frame_ring.h"
+#include "frame_source.h"
+#include "frame_transform.h"
+#include "publisher.h"
+#include "synthetic_source.h"
+
+/**
+ * @brief How fast a camera captures frames.
+ * */
+enum class CaptureRate {
+  /**
+   * @brief At the configured interval.
+   * */
+  kInterval,
+  /**
+   * @brief At the frame rate that a video file was recorded at, or at the
+   * configured interval if it is unknown.
+   * */
+  kNative,
+  /**
+   * @brief As fast as frames can be read.
+   * */
+  kMax
+};
+
+/**
+ * @brief The settings of one camera.
+ * */
+struct CameraOptions final {
+  /**
+   * @brief A video device index, the path of a video file, the path of a
+   * directory of images, or 'synthetic' for generated frames.
+   * */
+  std::string source{"0"};
+
+  int width{640};
+
+  int height{480};
+
+  /**
+   * @brief The interval at which to capture frames, in seconds.
+   * */
+  float interval{1.0F};
+
+  CaptureRate rate{CaptureRate::kInterval};
+
+  /**
+   * @brief Whether to start over once a video file or directory has been
+   * played back.
+   * */
+  bool loop{false};
+
+  /**
+   * @brief What to reduce frames to before they are encoded.
+   * */
+  FrameTransform transform;
+
+  /**
+   * @brief How to generate frames, if the source is synthetic.
+   * */
+  SyntheticOptions synthetic;
+
+  /**
+   * @brief The topic that the frames are published under, if the camera shares
+   * a socket with other cameras.
+   * */
+  std::string topic;
+
+  /**
+   * @brief The address of a socket of the camera's own. If empty, the camera
+   * publishes on the shared socket.
+   * */
+  std::string bind_address;
+
+  /**
+   * @brief Reads the settings of a camera from a list of 'key=value' pairs
+   * separated by commas, such as 'source=1,width=1280,topic=left'.
+   *
+   * @param defaults The settings to use for the keys that are not given.
+   *
+   * @return The settings, or nothing if the list could not be read.
+   * */
+  [[nodiscard]] static auto Parse(const std::string& spec,
+                                  const CameraOptions& defaults)
+      -> std::optional<CameraOptions>;
+
+  /**
+   * @brief A name for the camera to use in log messages.
+   * */
+  [[nodiscard]] auto Name() const -> std::string;
+
+  /**
+   * @brief Reads a capture rate of 'interval', 'native' or 'max'.
+   * */
+  [[nodiscard]] static auto ParseRate(const std::string& name)
+      -> std::optional<CaptureRate>;
+};
+
+/**
+ * @brief A video source that is captured on a thread of its own.
+ * */
+class Camera final {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  Camera(std::size_t index, CameraOptions options,
+         std::shared_ptr<Publisher> publisher);
+
+  [[nodiscard]] auto Open() -> bool;
+
+  /**
+   * @brief Reads frames on a fixed schedule into the frame ring, until the
+   * source fails or ends. Sources that are played back start over at the end
+   * if looping is enabled.
+   *
+   * @details Each frame is due at a whole number of intervals after the first,
+   * so that the time it takes to read a frame does not add up over time. If
+   * reading falls behind by whole intervals, those frames are skipped.
+   * */
+  void Capture(FrameRing& ring);
+
+  /**
+   * @brief Sends an encoded frame of this camera, unless a later frame has
+   * already been sent.
+   * */
+  void Publish(const FrameHeader& header,
+               const std::vector<std::uint8_t>& buffer);
+
+  /**
+   * @brief Logs the frame rates and drop counts since the last call.
+   * */
+  void LogStats(const FrameRing& ring);
+
+  [[nodiscard]] auto Options() const -> const CameraOptions& {
+    return options_;
+  }
+
+ protected:
+  /**
+   * @brief The interval between frames, in seconds, for the capture rate of
+   * the camera.
+   * */
+  [[nodiscard]] auto Interval() const -> float;
+
+ private:
+  std::size_t index_{};
+
+  CameraOptions options_;
+
+  std::shared_ptr<Publisher> publisher_;
+
+  std::unique_ptr<FrameSource> source_;
+
+  std::uint64_t sequence_{};
+
+  std::mutex publish_mutex_;
+
+  std::optional<std::uint64_t> last_published_;
+
+  std::atomic<std::uint64_t> num_captured_{};
+
+  std::atomic<std::uint64_t> num_published_{};
+
+  std::atomic<std::uint64_t> num_late_{};
+
+  clock::time_point last_stats_time_{clock::now()};
+
+  std::uint64_t last_captured_{};
+
+  std::uint64_t last_published_count_{};
+};
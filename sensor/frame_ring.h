@@ -0,0 +1,144 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief A frame as it was captured, before it is encoded.
+ * */
+struct CapturedFrame final {
+  cv::Mat image;
+
+  /**
+   * @brief The index of the camera that captured the frame.
+   * */
+  std::size_t camera{};
+
+  /**
+   * @brief The number of frames the camera captured before this one.
+   * */
+  std::uint64_t sequence{};
+
+  /**
+   * @brief The time at which the frame was captured, in microseconds since the
+   * Unix epoch.
+   * */
+  std::int64_t capture_time_us{};
+};
+
+/**
+ * @brief Fixed size queues of captured frames, one for each camera, between
+ * the capture threads and the encode threads.
+ *
+ * @details When the queue of a camera is full, its oldest frame is dropped to
+ * make room for the new one, so that a capture thread never waits on the encode
+ * threads, and a fast camera never pushes out the frames of a slow one. The
+ * encode threads take the oldest frame of all cameras first.
+ * */
+class FrameRing final {
+ public:
+  FrameRing(const std::size_t num_cameras, const std::size_t capacity)
+      : lanes_(num_cameras, Lane(capacity == 0 ? 1 : capacity)) {}
+
+  /**
+   * @brief Adds a frame to the queue of its camera, dropping the oldest frame
+   * of that camera if its queue is full.
+   *
+   * @return False if a frame was dropped.
+   * */
+  auto Push(CapturedFrame& frame) -> bool {
+    bool dropped{};
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto& lane = lanes_[frame.camera];
+      if (lane.size == lane.slots.size()) {
+        lane.head = (lane.head + 1) % lane.slots.size();
+        lane.size--;
+        lane.num_dropped++;
+        total_size_--;
+        dropped = true;
+      }
+      // Note: The frames are swapped, so that the memory of the slot is given
+      // back to the capture thread to read the next frame into.
+      std::swap(lane.slots[(lane.head + lane.size) % lane.slots.size()],
+                frame);
+      lane.size++;
+      total_size_++;
+    }
+    condition_.notify_one();
+    return !dropped;
+  }
+
+  /**
+   * @brief Takes the oldest frame of all cameras, waiting for one if all queues
+   * are empty.
+   *
+   * @return False if the queues have been closed and are empty.
+   * */
+  [[nodiscard]] auto Pop(CapturedFrame& frame) -> bool {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this]() { return (total_size_ > 0) || closed_; });
+    if (total_size_ == 0) {
+      return false;
+    }
+    Lane* oldest{};
+    for (auto& lane : lanes_) {
+      if ((lane.size > 0) &&
+          (!oldest || (lane.slots[lane.head].capture_time_us <
+                       oldest->slots[oldest->head].capture_time_us))) {
+        oldest = &lane;
+      }
+    }
+    std::swap(oldest->slots[oldest->head], frame);
+    oldest->head = (oldest->head + 1) % oldest->slots.size();
+    oldest->size--;
+    total_size_--;
+    return true;
+  }
+
+  /**
+   * @brief Wakes the encode threads, which finish the frames in the queues and
+   * then stop.
+   * */
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    condition_.notify_all();
+  }
+
+  [[nodiscard]] auto NumDropped(const std::size_t camera) const
+      -> std::uint64_t {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lanes_[camera].num_dropped;
+  }
+
+ private:
+  struct Lane final {
+    explicit Lane(const std::size_t capacity) : slots(capacity) {}
+
+    std::vector<CapturedFrame> slots;
+
+    std::size_t head{};
+
+    std::size_t size{};
+
+    std::uint64_t num_dropped{};
+  };
+
+  mutable std::mutex mutex_;
+
+  std::condition_variable condition_;
+
+  std::vector<Lane> lanes_;
+
+  std::size_t total_size_{};
+
+  bool closed_{};
+};
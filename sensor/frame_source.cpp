@@ -0,0 +1,136 @@
+#include "frame_source.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Reads frames from a video device or a video file.
+ * */
+class VideoSource final : public FrameSource {
+ public:
+  explicit VideoSource(const bool is_file) : is_file_(is_file) {}
+
+  [[nodiscard]] auto Capture() -> cv::VideoCapture& { return capture_; }
+
+  [[nodiscard]] auto Read(cv::Mat& frame) -> bool override {
+    return capture_.read(frame);
+  }
+
+  [[nodiscard]] auto Rewind() -> bool override {
+    return is_file_ && capture_.set(cv::CAP_PROP_POS_FRAMES, 0);
+  }
+
+  [[nodiscard]] auto NativeInterval() const -> std::optional<float> override {
+    const auto fps = capture_.get(cv::CAP_PROP_FPS);
+    if (!(fps > 0.0)) {
+      return std::nullopt;
+    }
+    return static_cast<float>(1.0 / fps);
+  }
+
+ private:
+  cv::VideoCapture capture_;
+
+  bool is_file_{};
+};
+
+/**
+ * @brief Reads the images of a directory, in the order of their names.
+ * */
+class DirectorySource final : public FrameSource {
+ public:
+  explicit DirectorySource(std::vector<std::string> paths)
+      : paths_(std::move(paths)) {}
+
+  [[nodiscard]] auto Read(cv::Mat& frame) -> bool override {
+    while (index_ < paths_.size()) {
+      frame = cv::imread(paths_[index_++], cv::IMREAD_COLOR);
+      if (!frame.empty()) {
+        return true;
+      }
+      SPDLOG_WARN("Failed to read '{}', skipping it.", paths_[index_ - 1]);
+    }
+    return false;
+  }
+
+  [[nodiscard]] auto Rewind() -> bool override {
+    index_ = 0;
+    return true;
+  }
+
+  [[nodiscard]] auto NativeInterval() const -> std::optional<float> override {
+    return std::nullopt;
+  }
+
+ private:
+  std::vector<std::string> paths_;
+
+  std::size_t index_{};
+};
+
+[[nodiscard]] auto IsImagePath(const std::filesystem::path& path) -> bool {
+  auto extension = path.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](const unsigned char c) { return std::tolower(c); });
+  return (extension == ".png") || (extension == ".jpg") ||
+         (extension == ".jpeg") || (extension == ".bmp") ||
+         (extension == ".tif") || (extension == ".tiff");
+}
+
+[[nodiscard]] auto IsDeviceIndex(const std::string& source) -> bool {
+  return !source.empty() &&
+         (source.find_first_not_of("0123456789") == std::string::npos);
+}
+
+}  // namespace
+
+auto FrameSource::Open(const std::string& source, const int width,
+                       const int height) -> std::unique_ptr<FrameSource> {
+  if (IsDeviceIndex(source)) {
+    auto device = std::make_unique<VideoSource>(false);
+    if (!device->Capture().open(std::atoi(source.c_str()))) {
+      SPDLOG_ERROR("Failed to open video device {}.", source);
+      return nullptr;
+    }
+    device->Capture().set(cv::CAP_PROP_FRAME_WIDTH, width);
+    device->Capture().set(cv::CAP_PROP_FRAME_HEIGHT, height);
+    return device;
+  }
+
+  std::error_code err;
+
+  if (std::filesystem::is_directory(source, err)) {
+    std::vector<std::string> paths;
+    for (const auto& entry :
+         std::filesystem::directory_iterator(source, err)) {
+      if (entry.is_regular_file() && IsImagePath(entry.path())) {
+        paths.emplace_back(entry.path().string());
+      }
+    }
+    if (paths.empty()) {
+      SPDLOG_ERROR("No images found in '{}'.", source);
+      return nullptr;
+    }
+    std::sort(paths.begin(), paths.end());
+    SPDLOG_INFO("Found {} images in '{}'.", paths.size(), source);
+    return std::make_unique<DirectorySource>(std::move(paths));
+  }
+
+  auto file = std::make_unique<VideoSource>(true);
+  if (!file->Capture().open(source)) {
+    SPDLOG_ERROR("Failed to open video file '{}'.", source);
+    return nullptr;
+  }
+  return file;
+}
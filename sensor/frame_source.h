@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <opencv2/core.hpp>
+#include <optional>
+#include <string>
+
+/**
+ * @brief Where the frames of a camera come from: a video device, a video file
+ * or a directory of images.
+ * */
+class FrameSource {
+ public:
+  /**
+   * @brief Opens a source.
+   *
+   * @param source A video device index, the path of a video file or the path of
+   * a directory of images.
+   *
+   * @return The source, or null if it could not be opened.
+   * */
+  [[nodiscard]] static auto Open(const std::string& source, int width,
+                                 int height) -> std::unique_ptr<FrameSource>;
+
+  virtual ~FrameSource() = default;
+
+  /**
+   * @brief Reads the next frame.
+   *
+   * @return False if the source failed or has no more frames.
+   * */
+  [[nodiscard]] virtual auto Read(cv::Mat& frame) -> bool = 0;
+
+  /**
+   * @brief Goes back to the first frame, for sources that are played back.
+   *
+   * @return False if the source cannot be rewound, such as a video device.
+   * */
+  [[nodiscard]] virtual auto Rewind() -> bool = 0;
+
+  /**
+   * @brief The interval, in seconds, between the frames of the source as it
+   * was recorded, if it is known.
+   * */
+  [[nodiscard]] virtual auto NativeInterval() const -> std::optional<float> = 0;
+};
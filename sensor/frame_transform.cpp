@@ -0,0 +1,84 @@
+#include "frame_transform.h"
+
+#include <spdlog/spdlog.h>
+
+#include <cstdio>
+
+auto FrameTransform::ParseCrop(const std::string& text)
+    -> std::optional<cv::Rect> {
+  cv::Rect rect;
+  char end{};
+  if ((std::sscanf(text.c_str(), "%dx%d+%d+%d%c", &rect.width, &rect.height,
+                   &rect.x, &rect.y, &end) != 4) ||
+      (rect.width <= 0) || (rect.height <= 0) || (rect.x < 0) || (rect.y < 0)) {
+    SPDLOG_ERROR("Invalid crop region '{}', expected 'WxH+X+Y'.", text);
+    return std::nullopt;
+  }
+  return rect;
+}
+
+auto FrameTransform::ParseSize(const std::string& text)
+    -> std::optional<cv::Size> {
+  cv::Size size;
+  char end{};
+  if ((std::sscanf(text.c_str(), "%dx%d%c", &size.width, &size.height, &end) !=
+       2) ||
+      (size.width <= 0) || (size.height <= 0)) {
+    SPDLOG_ERROR("Invalid size '{}', expected 'WxH'.", text);
+    return std::nullopt;
+  }
+  return size;
+}
+
+auto FrameTransform::ParseInterpolation(const std::string& name)
+    -> std::optional<int> {
+  if (name == "nearest") {
+    return cv::INTER_NEAREST;
+  }
+  if (name == "linear") {
+    return cv::INTER_LINEAR;
+  }
+  if (name == "cubic") {
+    return cv::INTER_CUBIC;
+  }
+  if (name == "area") {
+    return cv::INTER_AREA;
+  }
+  if (name == "lanczos") {
+    return cv::INTER_LANCZOS4;
+  }
+  SPDLOG_ERROR(
+      "Unknown interpolation '{}', expected nearest, linear, cubic, area or "
+      "lanczos.",
+      name);
+  return std::nullopt;
+}
+
+auto FrameTransform::Apply(const cv::Mat& frame, Buffers& buffers) const
+    -> cv::Mat {
+  cv::Mat image = frame;
+
+  // Note: A crop is a view into the frame, so it costs nothing by itself and
+  // shrinks the work of the steps after it.
+  if (crop) {
+    const auto region = *crop & cv::Rect(0, 0, frame.cols, frame.rows);
+    if (region.empty()) {
+      return cv::Mat();
+    }
+    image = image(region);
+  }
+
+  // Note: Monochrome cameras are usually reported as three identical channels,
+  // which would triple the size of each message.
+  if (gray && (image.channels() == 3)) {
+    cv::cvtColor(image, buffers.gray, cv::COLOR_BGR2GRAY);
+    image = buffers.gray;
+  }
+
+  if (size && (image.size() != *size)) {
+    cv::resize(image, buffers.resized, *size, 0.0, 0.0, interpolation);
+    image = buffers.resized;
+  }
+
+  return image;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <optional>
+#include <string>
+
+/**
+ * @brief Reduces a captured frame to the part that the pipeline needs, before
+ * it is encoded.
+ *
+ * @details The frame is first cropped, then converted to a single channel, and
+ * finally resized, so that each step works on as little data as possible.
+ * */
+struct FrameTransform final {
+  /**
+   * @brief The intermediate results of a transform, which are reused between
+   * frames to avoid allocating for each one.
+   * */
+  struct Buffers final {
+    cv::Mat gray;
+
+    cv::Mat resized;
+  };
+
+  /**
+   * @brief The region of the frame to keep. It is clipped to the frame.
+   * */
+  std::optional<cv::Rect> crop;
+
+  /**
+   * @brief The size to scale the (cropped) frame to.
+   * */
+  std::optional<cv::Size> size;
+
+  /**
+   * @brief The OpenCV interpolation flag to resize with.
+   * */
+  int interpolation{cv::INTER_AREA};
+
+  /**
+   * @brief Whether to publish single channel frames, for monochrome cameras.
+   * */
+  bool gray{false};
+
+  /**
+   * @brief Reads a crop region in the form 'WxH+X+Y', such as '640x480+16+0'.
+   * */
+  [[nodiscard]] static auto ParseCrop(const std::string& text)
+      -> std::optional<cv::Rect>;
+
+  /**
+   * @brief Reads a size in the form 'WxH', such as '320x240'.
+   * */
+  [[nodiscard]] static auto ParseSize(const std::string& text)
+      -> std::optional<cv::Size>;
+
+  /**
+   * @brief Reads an interpolation of 'nearest', 'linear', 'cubic', 'area' or
+   * 'lanczos'.
+   * */
+  [[nodiscard]] static auto ParseInterpolation(const std::string& name)
+      -> std::optional<int>;
+
+  /**
+   * @brief Applies the transform to a frame.
+   *
+   * @return The transformed frame, which shares its data with either the input
+   * or one of the buffers. It is empty if the crop region lies outside of the
+   * frame.
+   * */
+  [[nodiscard]] auto Apply(const cv::Mat& frame, Buffers& buffers) const
+      -> cv::Mat;
+};
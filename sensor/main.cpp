@@ -1,23 +1,39 @@
+#define CXXOPTS_VECTOR_DELIMITER ';'
+
 #include <spdlog/spdlog.h>
 #include <zmq.h>
 
-#include <cerrno>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdlib>
-#include <cstring>
 #include <cxxopts.hpp>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <opencv2/imgcodecs.hpp>
-#include <opencv2/videoio.hpp>
 #include <optional>
+#include <set>
 #include <string>
 #include <thread>
+#include <vector>
+
+#include "camera.h"
+#include "frame_ring.h"
+#include "publisher.h"
 
 namespace {
 
 struct Options final {
   int device_index{};
 
+  std::string source;
+
+  std::string rate{"interval"};
+
+  bool loop{false};
+
   std::string bind_address{"tcp://*:6020"};
 
   float interval{1.0F};
@@ -26,6 +42,22 @@ struct Options final {
 
   int height{480};
 
+  bool gray{false};
+
+  std::string crop;
+
+  std::string resize;
+
+  std::string interpolation{"area"};
+
+  SyntheticOptions synthetic;
+
+  int encode_threads{1};
+
+  int queue_size{2};
+
+  std::vector<std::string> cameras;
+
   bool help{false};
 
   void Parse(int argc, char** argv) {
@@ -33,6 +65,17 @@ struct Options final {
     options.add_options()  //
         ("d,device", "The video device to stream from.",
          cxxopts::value<int>()->default_value("0"))  //
+        ("s,source",
+         "A video file or a directory of images to play back instead of the "
+         "video device, or 'synthetic' to generate frames with anomalies. "
+         "'synthetic:<image>' draws the anomalies onto an image.",
+         cxxopts::value<std::string>()->default_value(""))  //
+        ("r,rate",
+         "How fast to capture frames: 'interval', 'native' for the frame rate "
+         "of a video file, or 'max' for as fast as possible.",
+         cxxopts::value<std::string>()->default_value("interval"))  //
+        ("l,loop", "Starts over once a video file or directory has ended.",
+         cxxopts::value<bool>()->implicit_value("true"))  //
         ("b,bind", "The address to bind the ZMQ publisher to.",
          cxxopts::value<std::string>()->default_value("tcp://*:6020"))  //
         ("w,width", "The width to capture frames at.",
@@ -41,39 +84,122 @@ struct Options final {
          cxxopts::value<int>()->default_value("480"))  //
         ("t,interval", "The interval at which to publish camera frames",
          cxxopts::value<float>()->default_value("1.0"))  //
+        ("g,gray", "Publishes single channel frames, for monochrome cameras.",
+         cxxopts::value<bool>()->implicit_value("true"))  //
+        ("crop",
+         "Publishes only a region of each frame, given as 'WxH+X+Y'. The "
+         "region is taken before resizing.",
+         cxxopts::value<std::string>()->default_value(""))  //
+        ("resize", "Scales frames to 'WxH' before they are published.",
+         cxxopts::value<std::string>()->default_value(""))  //
+        ("interpolation",
+         "How to resize frames: 'nearest', 'linear', 'cubic', 'area' or "
+         "'lanczos'.",
+         cxxopts::value<std::string>()->default_value("area"))  //
+        ("anomaly-probability",
+         "The probability that a synthetic frame has anomalies.",
+         cxxopts::value<float>()->default_value("0.1"))  //
+        ("max-anomalies",
+         "The largest number of anomalies in a synthetic frame.",
+         cxxopts::value<int>()->default_value("1"))  //
+        ("seed", "The seed for generating synthetic frames.",
+         cxxopts::value<std::uint64_t>()->default_value("0"))  //
+        ("ground-truth",
+         "A file to write the anomalies of synthetic frames to, as one JSON "
+         "object per line.",
+         cxxopts::value<std::string>()->default_value(""))  //
+        ("j,encode-threads", "The number of threads that encode frames.",
+         cxxopts::value<int>()->default_value("1"))  //
+        ("q,queue", "The number of captured frames to hold for encoding.",
+         cxxopts::value<int>()->default_value("2"))  //
+        ("c,camera",
+         "Adds a camera, as 'key=value' pairs separated by commas. The keys "
+         "are source, width, height, interval, rate, loop, crop, resize, "
+         "interpolation, gray, anomaly_probability, max_anomalies, seed, "
+         "ground_truth, topic and bind. Keys that are not given are taken from "
+         "the other options. May be given more than once. If not given, the "
+         "device or source option is used.",
+         cxxopts::value<std::vector<std::string>>())  //
         ("help", "Prints this help message.",
          cxxopts::value<bool>()->implicit_value("true"))  //
         ;
     const auto result = options.parse(argc, argv);
     device_index = result["device"].as<int>();
+    source = result["source"].as<std::string>();
+    rate = result["rate"].as<std::string>();
+    loop = result["loop"].as<bool>();
     bind_address = result["bind"].as<std::string>();
     interval = result["interval"].as<float>();
     width = result["width"].as<int>();
     height = result["height"].as<int>();
+    gray = result["gray"].as<bool>();
+    crop = result["crop"].as<std::string>();
+    resize = result["resize"].as<std::string>();
+    interpolation = result["interpolation"].as<std::string>();
+    synthetic.anomaly_probability = result["anomaly-probability"].as<float>();
+    synthetic.max_anomalies = result["max-anomalies"].as<int>();
+    synthetic.seed = result["seed"].as<std::uint64_t>();
+    synthetic.ground_truth_path = result["ground-truth"].as<std::string>();
+    encode_threads = result["encode-threads"].as<int>();
+    queue_size = result["queue"].as<int>();
+    if (result.count("camera") > 0) {
+      cameras = result["camera"].as<std::vector<std::string>>();
+    }
     help = result["help"].as<bool>();
     if (help) {
       std::cout << options.help();
     }
   }
+
+  /**
+   * @brief The settings that cameras take unless they give their own.
+   * */
+  [[nodiscard]] auto CameraDefaults() const -> std::optional<CameraOptions> {
+    const auto capture_rate = CameraOptions::ParseRate(rate);
+    if (!capture_rate) {
+      return std::nullopt;
+    }
+    CameraOptions defaults;
+    if (!crop.empty()) {
+      defaults.transform.crop = FrameTransform::ParseCrop(crop);
+      if (!defaults.transform.crop) {
+        return std::nullopt;
+      }
+    }
+    if (!resize.empty()) {
+      defaults.transform.size = FrameTransform::ParseSize(resize);
+      if (!defaults.transform.size) {
+        return std::nullopt;
+      }
+    }
+    const auto resize_interpolation =
+        FrameTransform::ParseInterpolation(interpolation);
+    if (!resize_interpolation) {
+      return std::nullopt;
+    }
+    defaults.transform.interpolation = *resize_interpolation;
+    defaults.transform.gray = gray;
+    defaults.source = source.empty() ? std::to_string(device_index) : source;
+    defaults.width = width;
+    defaults.height = height;
+    defaults.interval = interval;
+    defaults.rate = *capture_rate;
+    defaults.loop = loop;
+    defaults.synthetic = synthetic;
+    return defaults;
+  }
 };
 
 class Program final {
  public:
-  using clock = std::chrono::high_resolution_clock;
+  using clock = std::chrono::steady_clock;
 
-  using time_point = typename clock::time_point;
-
-  Program()
-      : zmq_context_(zmq_ctx_new()),
-        zmq_publisher_(zmq_socket(zmq_context_, ZMQ_PUB)) {
-    // The 'conflate' option keeps the outgoing queue to a size of one, and
-    // ensures its the latest message.
-    auto conflate{1};
-    zmq_setsockopt(zmq_publisher_, ZMQ_CONFLATE, &conflate, sizeof(conflate));
-  }
+  Program() : zmq_context_(zmq_ctx_new()) {}
 
   ~Program() {
-    zmq_close(zmq_publisher_);
+    // Note: The sockets must be closed before the context is destroyed.
+    cameras_.clear();
+    publishers_.clear();
     zmq_ctx_destroy(zmq_context_);
   }
 
@@ -92,83 +218,226 @@ class Program final {
                    options_.interval);
       return false;
     }
-    SPDLOG_INFO("Device Index: '{}'", options_.device_index);
+    if (options_.encode_threads < 1) {
+      SPDLOG_ERROR("At least one encode thread is needed.");
+      return false;
+    }
     SPDLOG_INFO("Bind Address: '{}'", options_.bind_address);
-    SPDLOG_INFO("Interval: {}", options_.interval);
-    SPDLOG_INFO("Resolution: {}x{}", options_.width, options_.height);
-    if (zmq_bind(zmq_publisher_, options_.bind_address.c_str()) != 0) {
-      SPDLOG_ERROR("Failed to bind to ZMQ address '{}': {}",
-                   options_.bind_address, std::strerror(errno));
+    SPDLOG_INFO("Grayscale: {}", options_.gray);
+    if (!options_.crop.empty()) {
+      SPDLOG_INFO("Crop: {}", options_.crop);
+    }
+    if (!options_.resize.empty()) {
+      SPDLOG_INFO("Resize: {} ({})", options_.resize, options_.interpolation);
+    }
+    SPDLOG_INFO("Encode Threads: {}", options_.encode_threads);
+    SPDLOG_INFO("Queue Size: {}", options_.queue_size);
+
+    const auto defaults = options_.CameraDefaults();
+    if (!defaults) {
       return false;
     }
-    SPDLOG_INFO("Opening video device.");
-    if (!m_video_device.open(options_.device_index)) {
-      SPDLOG_ERROR("Failed to open video device {}", options_.device_index);
+
+    std::vector<CameraOptions> camera_options;
+    if (options_.cameras.empty()) {
+      camera_options.emplace_back(*defaults);
+    }
+    for (const auto& spec : options_.cameras) {
+      auto parsed = CameraOptions::Parse(spec, *defaults);
+      if (!parsed) {
+        return false;
+      }
+      camera_options.emplace_back(std::move(*parsed));
+    }
+
+    std::set<std::string> ground_truth_paths;
+    for (const auto& camera : camera_options) {
+      const auto& path = camera.synthetic.ground_truth_path;
+      if (SyntheticSource::IsSynthetic(camera.source) && !path.empty() &&
+          !ground_truth_paths.insert(path).second) {
+        SPDLOG_ERROR("Synthetic cameras need ground truth files of their own.");
+        return false;
+      }
+    }
+
+    if (!CreatePublishers(camera_options)) {
       return false;
     }
-    SPDLOG_INFO("Video device open.");
-    m_video_device.set(cv::CAP_PROP_FRAME_WIDTH, options_.width);
-    m_video_device.set(cv::CAP_PROP_FRAME_HEIGHT, options_.height);
+
+    for (std::size_t i = 0; i < camera_options.size(); i++) {
+      const auto& address = camera_options[i].bind_address.empty()
+                                ? options_.bind_address
+                                : camera_options[i].bind_address;
+      auto camera = std::make_unique<Camera>(i, camera_options[i],
+                                             publishers_.at(address));
+      if (!camera->Open()) {
+        return false;
+      }
+      cameras_.emplace_back(std::move(camera));
+    }
+
+    ring_ = std::make_unique<FrameRing>(cameras_.size(), options_.queue_size);
+
     return true;
   }
 
-  [[nodiscard]] auto NextFrame() -> bool {
-    if (last_timestamp_) {
-      const auto t = clock::now();
-
-      const auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(
-                          t - last_timestamp_.value())
-                          .count();
-      const auto interval_ms = static_cast<int>(options_.interval * 1000);
-      if (dt > interval_ms) {
-        SPDLOG_WARN("Fell {} [ms] behind schedule.", dt - interval_ms);
-      } else if (dt < interval_ms) {
-        std::this_thread::sleep_for(
-            std::chrono::milliseconds(interval_ms - dt));
+  /**
+   * @brief Captures and publishes frames until every camera has failed or
+   * ended.
+   *
+   * @details Each camera is captured on a thread of its own, and the frames of
+   * all cameras are encoded and published on a shared pool of threads, so that
+   * the time it takes to encode a frame does not delay the capture of the next
+   * one.
+   * */
+  void Run() {
+    std::vector<std::thread> capture_threads;
+    for (auto& camera : cameras_) {
+      capture_threads.emplace_back([this, &camera]() {
+        camera->Capture(*ring_);
+        CameraStopped();
+      });
+    }
+
+    std::vector<std::thread> encode_threads;
+    for (int i = 0; i < options_.encode_threads; i++) {
+      encode_threads.emplace_back([this]() { Encode(); });
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(stop_mutex_);
+      while (!stop_condition_.wait_for(lock, stats_interval, [this]() {
+        return num_stopped_ == cameras_.size();
+      })) {
+        lock.unlock();
+        LogStats();
+        lock.lock();
       }
     }
 
-    cv::Mat frame;
+    for (auto& thread : capture_threads) {
+      thread.join();
+    }
+    ring_->Close();
+    for (auto& thread : encode_threads) {
+      thread.join();
+    }
 
-    if (!m_video_device.read(frame)) {
-      SPDLOG_ERROR("Failed to read frame from video device.");
-      return false;
+    LogStats();
+  }
+
+ protected:
+  /**
+   * @brief Creates a socket for each address that cameras publish on.
+   *
+   * @details Cameras that share a socket must have topics, so that subscribers
+   * can tell their frames apart.
+   * */
+  [[nodiscard]] auto CreatePublishers(
+      const std::vector<CameraOptions>& camera_options) -> bool {
+    std::map<std::string, std::vector<const CameraOptions*>> by_address;
+    for (const auto& camera : camera_options) {
+      by_address[camera.bind_address.empty() ? options_.bind_address
+                                             : camera.bind_address]
+          .emplace_back(&camera);
     }
 
-    last_timestamp_ = clock::now();
+    for (const auto& [address, cameras] : by_address) {
+      if (cameras.size() > 1) {
+        for (const auto* camera : cameras) {
+          if (camera->topic.empty()) {
+            SPDLOG_ERROR(
+                "Camera '{}' shares '{}' with other cameras, so it needs a "
+                "topic.",
+                camera->source, address);
+            return false;
+          }
+        }
+      }
+      auto publisher = std::make_shared<Publisher>(zmq_context_, cameras.size());
+      if (!publisher->Bind(address)) {
+        return false;
+      }
+      SPDLOG_INFO("Publishing {} camera(s) on '{}'.", cameras.size(), address);
+      publishers_.emplace(address, std::move(publisher));
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief Reduces, encodes and publishes captured frames until the frame ring
+   * is closed.
+   *
+   * @details Frames are cropped, converted and resized here rather than on the
+   * capture thread, so that the capture schedule is not delayed, and before
+   * they are encoded, so that there is less to encode, send and decode.
+   * */
+  void Encode() {
+    CapturedFrame frame;
+
+    FrameTransform::Buffers buffers;
 
     std::vector<std::uint8_t> buffer;
 
-    if (!cv::imencode(".png", frame, buffer)) {
-      SPDLOG_ERROR("Failed to encode image.");
-      return false;
-    }
+    while (ring_->Pop(frame)) {
+      const auto& transform = cameras_[frame.camera]->Options().transform;
 
-    zmq_msg_t msg{};
+      const auto image = transform.Apply(frame.image, buffers);
+      if (image.empty()) {
+        SPDLOG_ERROR("The crop region lies outside of the {}x{} frame.",
+                     frame.image.cols, frame.image.rows);
+        continue;
+      }
 
-    zmq_msg_init_size(&msg, buffer.size());
+      if (!cv::imencode(".png", image, buffer)) {
+        SPDLOG_ERROR("Failed to encode image.");
+        continue;
+      }
 
-    std::memcpy(zmq_msg_data(&msg), buffer.data(), buffer.size());
+      FrameHeader header;
+      header.sequence = frame.sequence;
+      header.capture_time_us = frame.capture_time_us;
 
-    if (zmq_msg_send(&msg, zmq_publisher_, 0) < 0) {
-      SPDLOG_WARN("Failed to send message.");
+      cameras_[frame.camera]->Publish(header, buffer);
     }
+  }
 
-    zmq_msg_close(&msg);
+  void CameraStopped() {
+    {
+      std::lock_guard<std::mutex> lock(stop_mutex_);
+      num_stopped_++;
+    }
+    stop_condition_.notify_all();
+  }
 
-    return true;
+  void LogStats() {
+    for (auto& camera : cameras_) {
+      camera->LogStats(*ring_);
+    }
   }
 
  private:
+  /**
+   * @brief How often to log the frame rates and drop counts.
+   * */
+  static constexpr std::chrono::seconds stats_interval{10};
+
   Options options_;
 
   void* zmq_context_{};
 
-  void* zmq_publisher_{};
+  std::map<std::string, std::shared_ptr<Publisher>> publishers_;
 
-  cv::VideoCapture m_video_device;
+  std::vector<std::unique_ptr<Camera>> cameras_;
 
-  std::optional<time_point> last_timestamp_;
+  std::unique_ptr<FrameRing> ring_;
+
+  std::mutex stop_mutex_;
+
+  std::condition_variable stop_condition_;
+
+  std::size_t num_stopped_{};
 };
 
 }  // namespace
@@ -178,7 +447,6 @@ auto main(int argc, char** argv) -> int {
   if (!program.Setup(argc, argv)) {
     return EXIT_FAILURE;
   }
-  while (program.NextFrame()) {
-  }
+  program.Run();
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,63 @@
+#include "publisher.h"
+
+#include <spdlog/spdlog.h>
+#include <zmq.h>
+
+#include <cerrno>
+#include <cstring>
+
+Publisher::Publisher(void* zmq_context, const std::size_t num_cameras)
+    : socket_(zmq_socket(zmq_context, ZMQ_PUB)) {
+  if (num_cameras <= 1) {
+    // The 'conflate' option keeps the outgoing queue to a size of one, and
+    // ensures its the latest message.
+    auto conflate{1};
+    zmq_setsockopt(socket_, ZMQ_CONFLATE, &conflate, sizeof(conflate));
+  } else {
+    auto hwm = static_cast<int>(num_cameras * 2);
+    zmq_setsockopt(socket_, ZMQ_SNDHWM, &hwm, sizeof(hwm));
+  }
+}
+
+Publisher::~Publisher() { zmq_close(socket_); }
+
+auto Publisher::Bind(const std::string& address) -> bool {
+  if (zmq_bind(socket_, address.c_str()) != 0) {
+    SPDLOG_ERROR("Failed to bind to ZMQ address '{}': {}", address,
+                 std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+auto Publisher::Send(const std::string& topic, const FrameHeader& header,
+                     const std::vector<std::uint8_t>& buffer) -> bool {
+  const auto prefix_size = topic.empty() ? 0 : (topic.size() + 1);
+
+  zmq_msg_t msg{};
+
+  zmq_msg_init_size(&msg, prefix_size + sizeof(header) + buffer.size());
+
+  auto* data = static_cast<std::uint8_t*>(zmq_msg_data(&msg));
+
+  if (prefix_size > 0) {
+    std::memcpy(data, topic.data(), topic.size());
+    data[topic.size()] = 0;
+  }
+
+  std::memcpy(data + prefix_size, &header, sizeof(header));
+
+  std::memcpy(data + prefix_size + sizeof(header), buffer.data(),
+              buffer.size());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const auto sent = zmq_msg_send(&msg, socket_, 0) >= 0;
+  if (!sent) {
+    SPDLOG_WARN("Failed to send message.");
+  }
+
+  zmq_msg_close(&msg);
+
+  return sent;
+}
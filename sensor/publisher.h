@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "frame_header.h"
+
+/**
+ * @brief A ZMQ publisher socket that one or more cameras send their frames on.
+ *
+ * @details If only one camera uses the socket, the socket conflates its queue,
+ * so that only the latest frame is ever sent. If several cameras share it, each
+ * message starts with the topic of its camera followed by a zero byte, so that
+ * subscribers can pick a camera. Since conflation would drop the frames of the
+ * other cameras, a shared socket instead keeps a short queue.
+ * */
+class Publisher final {
+ public:
+  /**
+   * @param num_cameras The number of cameras that send on the socket.
+   * */
+  Publisher(void* zmq_context, std::size_t num_cameras);
+
+  Publisher(const Publisher&) = delete;
+
+  auto operator=(const Publisher&) -> Publisher& = delete;
+
+  ~Publisher();
+
+  [[nodiscard]] auto Bind(const std::string& address) -> bool;
+
+  /**
+   * @brief Sends an encoded frame.
+   *
+   * @note This may be called from several threads at once.
+   *
+   * @param topic The topic of the camera, or empty if the camera does not
+   * share the socket.
+   * */
+  [[nodiscard]] auto Send(const std::string& topic, const FrameHeader& header,
+                          const std::vector<std::uint8_t>& buffer) -> bool;
+
+ private:
+  void* socket_{};
+
+  /**
+   * @brief ZMQ sockets may not be used from several threads at once, so the
+   * encode threads take turns.
+   * */
+  std::mutex mutex_;
+};
@@ -0,0 +1,89 @@
+#include "synthetic_source.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <utility>
+
+auto SyntheticSource::IsSynthetic(const std::string& source) -> bool {
+  return source.starts_with(prefix) &&
+         ((source.size() == std::char_traits<char>::length(prefix)) ||
+          (source[std::char_traits<char>::length(prefix)] == ':'));
+}
+
+auto SyntheticSource::Open(const std::string& source, const int width,
+                           const int height, const SyntheticOptions& options)
+    -> std::unique_ptr<SyntheticSource> {
+  const auto separator = source.find(':');
+
+  cv::Mat background;
+
+  if (separator == std::string::npos) {
+    background = synthetic::ProceduralTexture(width, height, 3, options.seed);
+  } else {
+    const auto path = source.substr(separator + 1);
+    const auto base = cv::imread(path, cv::IMREAD_COLOR);
+    if (base.empty()) {
+      SPDLOG_ERROR("Failed to read base image '{}'.", path);
+      return nullptr;
+    }
+    cv::resize(base, background, cv::Size(width, height), 0.0, 0.0,
+               cv::INTER_AREA);
+  }
+
+  if ((background.cols < synthetic::default_max_anomaly_size) ||
+      (background.rows < synthetic::default_max_anomaly_size)) {
+    SPDLOG_ERROR("Synthetic frames must be at least {}x{}.",
+                 synthetic::default_max_anomaly_size,
+                 synthetic::default_max_anomaly_size);
+    return nullptr;
+  }
+
+  auto synthetic =
+      std::make_unique<SyntheticSource>(std::move(background), options);
+
+  if (!options.ground_truth_path.empty()) {
+    synthetic->ground_truth_.open(options.ground_truth_path, std::ios::trunc);
+    if (!synthetic->ground_truth_) {
+      SPDLOG_ERROR("Failed to open '{}' for the ground truth.",
+                   options.ground_truth_path);
+      return nullptr;
+    }
+  }
+
+  SPDLOG_INFO("Generating {}x{} frames with an anomaly probability of {}.",
+              width, height, options.anomaly_probability);
+
+  return synthetic;
+}
+
+SyntheticSource::SyntheticSource(cv::Mat background,
+                                 const SyntheticOptions& options)
+    : background_(std::move(background)),
+      options_(options),
+      rng_(options.seed) {}
+
+auto SyntheticSource::Read(cv::Mat& frame) -> bool {
+  frame.create(background_.rows, background_.cols, background_.type());
+
+  synthetic::DrawBackground(background_, sequence_, frame);
+
+  synthetic::DrawAnomalies(
+      frame, options_.anomaly_probability,
+      static_cast<std::uint32_t>(std::max(options_.max_anomalies, 1)),
+      synthetic::all_kinds, synthetic::default_min_anomaly_size,
+      synthetic::default_max_anomaly_size, rng_, anomalies_);
+
+  if (ground_truth_.is_open()) {
+    ground_truth_ << synthetic::GroundTruthJson(sequence_, anomalies_) << '\n';
+    // Note: The stream may be stopped at any time, so the ground truth is
+    // flushed with each frame rather than at the end.
+    ground_truth_.flush();
+  }
+
+  sequence_++;
+
+  return true;
+}
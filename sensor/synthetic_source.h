@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <opencv2/core.hpp>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "frame_source.h"
+#include "synthetic_anomalies.h"
+
+/**
+ * @brief The settings of a synthetic source.
+ * */
+struct SyntheticOptions final {
+  /**
+   * @brief The probability that a frame has anomalies.
+   * */
+  float anomaly_probability{0.1F};
+
+  /**
+   * @brief The largest number of anomalies in a frame that has anomalies.
+   * */
+  int max_anomalies{1};
+
+  /**
+   * @brief The seed of the random number generator, so that runs can be
+   * repeated.
+   *
+   * @note Without a base image, the frames are the same as those of the
+   * synthetic source of the pipeline with the same seed, size and
+   * probabilities, as long as it draws three channels and all kinds of
+   * anomalies at their default sizes.
+   * */
+  std::uint64_t seed{};
+
+  /**
+   * @brief A file to write the ground truth of each frame to, as one JSON
+   * object per line. If empty, the ground truth is not written.
+   * */
+  std::string ground_truth_path;
+};
+
+/**
+ * @brief Generates frames with synthetic anomalies at known positions: filled
+ * patches, scratches and color shifts.
+ *
+ * @details The anomalies are drawn onto a base image, or onto a procedural
+ * texture without one. The background shifts by a few pixels each frame, so
+ * that no two frames are alike. The ground truth is written in the same format
+ * as the synthetic source of the pipeline, with the sequence number that the
+ * frame is published with.
+ * */
+class SyntheticSource final : public FrameSource {
+ public:
+  /**
+   * @brief The prefix of the sources that are generated, which may be followed
+   * by ':' and the path of a base image.
+   * */
+  static constexpr const char* prefix{"synthetic"};
+
+  [[nodiscard]] static auto IsSynthetic(const std::string& source) -> bool;
+
+  /**
+   * @return The source, or null if the base image or the ground truth file
+   * could not be opened.
+   * */
+  [[nodiscard]] static auto Open(const std::string& source, int width,
+                                 int height, const SyntheticOptions& options)
+      -> std::unique_ptr<SyntheticSource>;
+
+  SyntheticSource(cv::Mat background, const SyntheticOptions& options);
+
+  [[nodiscard]] auto Read(cv::Mat& frame) -> bool override;
+
+  /**
+   * @brief Does nothing, since the frames never run out.
+   * */
+  [[nodiscard]] auto Rewind() -> bool override { return true; }
+
+  [[nodiscard]] auto NativeInterval() const -> std::optional<float> override {
+    return std::nullopt;
+  }
+
+ private:
+  cv::Mat background_;
+
+  SyntheticOptions options_;
+
+  std::mt19937_64 rng_;
+
+  std::ofstream ground_truth_;
+
+  /**
+   * @brief The anomalies of the current frame, kept to reuse their storage.
+   * */
+  std::vector<synthetic::Anomaly> anomalies_;
+
+  /**
+   * @brief The number of frames generated so far, which is the sequence number
+   * of the next frame since the camera numbers every frame that it reads.
+   * */
+  std::uint64_t sequence_{};
+};
@@ -0,0 +1,102 @@
+#include "camera.h"
+
+#include <gtest/gtest.h>
+
+#include <opencv2/imgproc.hpp>
+
+TEST(FrameTransformTest, ParsesCrop) {
+  const auto crop = FrameTransform::ParseCrop("640x480+16+0");
+
+  ASSERT_TRUE(crop.has_value());
+  EXPECT_EQ(*crop, cv::Rect(16, 0, 640, 480));
+}
+
+TEST(FrameTransformTest, RejectsInvalidCrop) {
+  for (const auto* text :
+       {"", "640x480", "640x480+16", "640x480+16+0px", "0x480+0+0",
+        "640x480+-1+0", "640x-480+0+0"}) {
+    EXPECT_FALSE(FrameTransform::ParseCrop(text).has_value()) << text;
+  }
+}
+
+TEST(FrameTransformTest, ParsesSize) {
+  const auto size = FrameTransform::ParseSize("320x240");
+
+  ASSERT_TRUE(size.has_value());
+  EXPECT_EQ(*size, cv::Size(320, 240));
+}
+
+TEST(FrameTransformTest, RejectsInvalidSize) {
+  for (const auto* text :
+       {"", "320", "320x", "320x240x3", "0x240", "-320x240"}) {
+    EXPECT_FALSE(FrameTransform::ParseSize(text).has_value()) << text;
+  }
+}
+
+TEST(FrameTransformTest, ParsesInterpolation) {
+  EXPECT_EQ(FrameTransform::ParseInterpolation("nearest"), cv::INTER_NEAREST);
+  EXPECT_EQ(FrameTransform::ParseInterpolation("linear"), cv::INTER_LINEAR);
+  EXPECT_EQ(FrameTransform::ParseInterpolation("cubic"), cv::INTER_CUBIC);
+  EXPECT_EQ(FrameTransform::ParseInterpolation("area"), cv::INTER_AREA);
+  EXPECT_EQ(FrameTransform::ParseInterpolation("lanczos"),
+            cv::INTER_LANCZOS4);
+  EXPECT_FALSE(FrameTransform::ParseInterpolation("bilinear").has_value());
+}
+
+TEST(CameraOptionsTest, ParsesSettings) {
+  const auto options = CameraOptions::Parse(
+      "source=synthetic,width=1280,height=720,interval=0.5,rate=max,loop=true,"
+      "crop=640x480+16+0,resize=320x240,interpolation=area,gray=1,"
+      "anomaly_probability=0.25,max_anomalies=3,seed=18446744073709551615,"
+      "ground_truth=truth.jsonl,topic=left,bind=tcp://*:6021",
+      CameraOptions{});
+
+  ASSERT_TRUE(options.has_value());
+  EXPECT_EQ(options->source, "synthetic");
+  EXPECT_EQ(options->width, 1280);
+  EXPECT_EQ(options->height, 720);
+  EXPECT_FLOAT_EQ(options->interval, 0.5F);
+  EXPECT_EQ(options->rate, CaptureRate::kMax);
+  EXPECT_TRUE(options->loop);
+  EXPECT_EQ(options->transform.crop, cv::Rect(16, 0, 640, 480));
+  EXPECT_EQ(options->transform.size, cv::Size(320, 240));
+  EXPECT_EQ(options->transform.interpolation, cv::INTER_AREA);
+  EXPECT_TRUE(options->transform.gray);
+  EXPECT_FLOAT_EQ(options->synthetic.anomaly_probability, 0.25F);
+  EXPECT_EQ(options->synthetic.max_anomalies, 3);
+  EXPECT_EQ(options->synthetic.seed, 18446744073709551615ULL);
+  EXPECT_EQ(options->synthetic.ground_truth_path, "truth.jsonl");
+  EXPECT_EQ(options->topic, "left");
+  EXPECT_EQ(options->bind_address, "tcp://*:6021");
+  EXPECT_EQ(options->Name(), "left");
+}
+
+TEST(CameraOptionsTest, KeepsDefaultsOfMissingKeys) {
+  CameraOptions defaults;
+  defaults.width = 320;
+  defaults.topic = "shared";
+
+  const auto options = CameraOptions::Parse("source=1", defaults);
+
+  ASSERT_TRUE(options.has_value());
+  EXPECT_EQ(options->source, "1");
+  EXPECT_EQ(options->width, 320);
+  EXPECT_EQ(options->height, defaults.height);
+  EXPECT_EQ(options->topic, "shared");
+}
+
+TEST(CameraOptionsTest, NamesCameraAfterSourceWithoutTopic) {
+  const auto options = CameraOptions::Parse("source=video.mp4", {});
+
+  ASSERT_TRUE(options.has_value());
+  EXPECT_EQ(options->Name(), "video.mp4");
+}
+
+TEST(CameraOptionsTest, RejectsInvalidSettings) {
+  for (const auto* spec :
+       {"source", "colour=red", "width=wide", "rate=sometimes",
+        "crop=640x480", "resize=320", "interpolation=bilinear",
+        "interval=-1", "anomaly_probability=1.5"}) {
+    EXPECT_FALSE(CameraOptions::Parse(spec, {}).has_value()) << spec;
+  }
+}
@@ -0,0 +1,124 @@
+#include "frame_ring.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+namespace {
+
+[[nodiscard]] auto MakeFrame(const std::size_t camera,
+                             const std::uint64_t sequence,
+                             const std::int64_t capture_time_us)
+    -> CapturedFrame {
+  CapturedFrame frame;
+  frame.camera = camera;
+  frame.sequence = sequence;
+  frame.capture_time_us = capture_time_us;
+  return frame;
+}
+
+/**
+ * @brief Closes the ring and takes the frames that are left in it, returning
+ * their capture times in the order they were taken.
+ * */
+[[nodiscard]] auto Drain(FrameRing& ring) -> std::vector<std::int64_t> {
+  ring.Close();
+  std::vector<std::int64_t> times;
+  CapturedFrame frame;
+  while (ring.Pop(frame)) {
+    times.emplace_back(frame.capture_time_us);
+  }
+  return times;
+}
+
+}  // namespace
+
+TEST(FrameRingTest, TakesOldestFrameOfAllCameras) {
+  FrameRing ring(2, 4);
+
+  for (auto frame : {MakeFrame(0, 0, 10), MakeFrame(1, 0, 5),
+                     MakeFrame(0, 1, 20), MakeFrame(1, 1, 15)}) {
+    EXPECT_TRUE(ring.Push(frame));
+  }
+
+  EXPECT_EQ(Drain(ring), (std::vector<std::int64_t>{5, 10, 15, 20}));
+}
+
+TEST(FrameRingTest, DropsOldestFrameOfFullCamera) {
+  FrameRing ring(2, 2);
+
+  auto slow = MakeFrame(1, 0, 0);
+  EXPECT_TRUE(ring.Push(slow));
+
+  for (std::uint64_t i = 0; i < 3; i++) {
+    auto frame = MakeFrame(0, i, static_cast<std::int64_t>(10 * (i + 1)));
+    EXPECT_EQ(ring.Push(frame), i < 2);
+  }
+
+  EXPECT_EQ(ring.NumDropped(0), 1);
+  EXPECT_EQ(ring.NumDropped(1), 0);
+
+  // Note: The frame of the slow camera is kept, even though the fast camera
+  // filled its own queue after it.
+  EXPECT_EQ(Drain(ring), (std::vector<std::int64_t>{0, 20, 30}));
+}
+
+TEST(FrameRingTest, KeepsOneFrameWithoutCapacity) {
+  FrameRing ring(1, 0);
+
+  auto first = MakeFrame(0, 0, 1);
+  auto second = MakeFrame(0, 1, 2);
+
+  EXPECT_TRUE(ring.Push(first));
+  EXPECT_FALSE(ring.Push(second));
+
+  EXPECT_EQ(Drain(ring), (std::vector<std::int64_t>{2}));
+}
+
+TEST(FrameRingTest, HandsBackMemoryOfSlot) {
+  FrameRing ring(1, 1);
+
+  auto frame = MakeFrame(0, 7, 1);
+  EXPECT_TRUE(ring.Push(frame));
+
+  // Note: The pushed frame was swapped with the empty slot.
+  EXPECT_EQ(frame.sequence, 0);
+
+  CapturedFrame taken = MakeFrame(0, 9, 0);
+  ASSERT_TRUE(ring.Pop(taken));
+  EXPECT_EQ(taken.sequence, 7);
+}
+
+TEST(FrameRingTest, CloseWakesWaitingPop) {
+  FrameRing ring(1, 1);
+
+  bool popped{true};
+  std::thread consumer([&ring, &popped]() {
+    CapturedFrame frame;
+    popped = ring.Pop(frame);
+  });
+
+  ring.Close();
+  consumer.join();
+
+  EXPECT_FALSE(popped);
+}
+
+TEST(FrameRingTest, PopWaitsForPush) {
+  FrameRing ring(1, 1);
+
+  std::int64_t time{};
+  std::thread consumer([&ring, &time]() {
+    CapturedFrame frame;
+    if (ring.Pop(frame)) {
+      time = frame.capture_time_us;
+    }
+  });
+
+  auto frame = MakeFrame(0, 0, 42);
+  EXPECT_TRUE(ring.Push(frame));
+  consumer.join();
+
+  EXPECT_EQ(time, 42);
+}
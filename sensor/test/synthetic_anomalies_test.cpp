@@ -0,0 +1,68 @@
+#include "synthetic_anomalies.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+TEST(GroundTruthJsonTest, WritesFrameWithoutAnomalies) {
+  EXPECT_EQ(synthetic::GroundTruthJson(0, {}),
+            R"({"sequence":"0","anomalies":[]})");
+}
+
+TEST(GroundTruthJsonTest, WritesEveryAnomaly) {
+  const std::vector<synthetic::Anomaly> anomalies{
+      {synthetic::AnomalyKind::kPatch, 1, 2, 16, 17},
+      {synthetic::AnomalyKind::kScratch, 0, 0, 20, 3},
+      {synthetic::AnomalyKind::kColorShift, 30, 40, 50, 60}};
+
+  EXPECT_EQ(synthetic::GroundTruthJson(12, anomalies),
+            R"({"sequence":"12","anomalies":[)"
+            R"({"kind":"PATCH","x":1,"y":2,"width":16,"height":17},)"
+            R"({"kind":"SCRATCH","x":0,"y":0,"width":20,"height":3},)"
+            R"({"kind":"COLOR_SHIFT","x":30,"y":40,"width":50,"height":60}]})");
+}
+
+TEST(GroundTruthJsonTest, WritesSequenceAsString) {
+  EXPECT_EQ(synthetic::GroundTruthJson(18446744073709551615ULL, {}),
+            R"({"sequence":"18446744073709551615","anomalies":[]})");
+}
+
+TEST(DrawAnomaliesTest, DrawsSameAnomaliesForSameSeed) {
+  const auto background = synthetic::ProceduralTexture(128, 96, 3, 5);
+
+  cv::Mat frames[2];
+  std::vector<synthetic::Anomaly> anomalies[2];
+  for (int i = 0; i < 2; i++) {
+    std::mt19937_64 rng(5);
+    frames[i] = background.clone();
+    synthetic::DrawAnomalies(frames[i], 1.0, 4, synthetic::all_kinds,
+                             synthetic::default_min_anomaly_size,
+                             synthetic::default_max_anomaly_size, rng,
+                             anomalies[i]);
+  }
+
+  ASSERT_FALSE(anomalies[0].empty());
+  EXPECT_EQ(synthetic::GroundTruthJson(0, anomalies[0]),
+            synthetic::GroundTruthJson(0, anomalies[1]));
+  EXPECT_EQ(std::memcmp(frames[0].data, frames[1].data,
+                        frames[0].total() * frames[0].elemSize()),
+            0);
+
+  for (const auto& anomaly : anomalies[0]) {
+    EXPECT_GE(anomaly.x, 0);
+    EXPECT_GE(anomaly.y, 0);
+    EXPECT_LE(anomaly.x + anomaly.width, background.cols);
+    EXPECT_LE(anomaly.y + anomaly.height, background.rows);
+  }
+}
+
+TEST(DrawAnomaliesTest, DrawsNothingWithoutProbability) {
+  auto frame = synthetic::ProceduralTexture(64, 64, 3, 1);
+  std::mt19937_64 rng(1);
+  std::vector<synthetic::Anomaly> anomalies{{}};
+
+  synthetic::DrawAnomalies(frame, 0.0, 4, synthetic::all_kinds, 16, 32, rng,
+                           anomalies);
+
+  EXPECT_TRUE(anomalies.empty());
+}